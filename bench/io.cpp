@@ -0,0 +1,88 @@
+// Runtime I/O benchmark: run a program echoing a million integers read with getint() and report how long it takes.
+//
+// usage: io-bench <program> <work dir> <budget ms>
+// The program prints every integer on its own line, then their sum. Fails if the output is wrong or the median
+// run is slower than the budget.
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+extern char** environ;
+
+static const int Count = 1000000;
+static const int Runs = 5;
+
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        std::fprintf(stderr, "usage: %s <program> <work dir> <budget ms>\n", argv[0]);
+        return 2;
+    }
+    std::string inPath = std::string(argv[2]) + "/io.in", outPath = std::string(argv[2]) + "/io.out";
+    double budget = std::atof(argv[3]);
+
+    // full range integers, with the separators of real inputs
+    std::ostringstream input, expected;
+    input << Count << "\n";
+    uint32_t state = 1, sum = 0;
+    for (int i = 0; i < Count; i++) {
+        state = state * 1664525u + 1013904223u;
+        auto value = static_cast<int32_t>(state);
+        input << value << (i % 10 == 9 ? "\n" : " ");
+        expected << value << "\n";
+        sum += state;
+    }
+    expected << static_cast<int32_t>(sum) << "\n";
+    std::ofstream(inPath) << input.str();
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 0, inPath.c_str(), O_RDONLY, 0);
+    posix_spawn_file_actions_addopen(&actions, 1, outPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    char* args[] = {argv[1], nullptr};
+
+    std::vector<double> times;
+    for (int i = 0; i < Runs; i++) {
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid;
+        if (posix_spawn(&pid, argv[1], &actions, nullptr, args, environ) != 0) {
+            std::perror("cannot run the program");
+            return 1;
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        auto end = std::chrono::steady_clock::now();
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+            std::fprintf(stderr, "the program failed\n");
+            return 1;
+        }
+        times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    posix_spawn_file_actions_destroy(&actions);
+
+    std::ifstream output(outPath);
+    std::stringstream actual;
+    actual << output.rdbuf();
+    if (actual.str() != expected.str()) {
+        std::fprintf(stderr, "wrong output\n");
+        return 1;
+    }
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    std::printf("io: %d integers, min %.2f ms, median %.2f ms (budget %.0f ms)\n", Count, times.front(), median,
+                budget);
+    if (median > budget) {
+        std::fprintf(stderr, "I/O regression: the median is over the budget\n");
+        return 1;
+    }
+    return 0;
+}
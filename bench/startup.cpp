@@ -0,0 +1,67 @@
+// Startup benchmark: run the compiler on a tiny source many times and report how long it takes until its output
+// is written.
+//
+// usage: startup-bench <compiler> <source> <output> <budget ms> [compiler options...]
+// Fails if the median run is slower than the budget, or if the compiler fails.
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/wait.h>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+extern char** environ;
+
+static const int Warmup = 3;
+static const int Runs = 30;
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        std::fprintf(stderr, "usage: %s <compiler> <source> <output> <budget ms> [options...]\n", argv[0]);
+        return 2;
+    }
+    double budget = std::atof(argv[4]);
+    std::vector<char*> args = {argv[1], const_cast<char*>("-s")};
+    args.insert(args.end(), argv + 5, argv + argc);
+    args.insert(args.end(), {argv[2], const_cast<char*>("-o"), argv[3], nullptr});
+
+    // the compiler logs to stderr, which would only measure the terminal
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_addopen(&actions, 2, "/dev/null", O_WRONLY, 0);
+
+    std::vector<double> times;
+    for (int i = 0; i < Warmup + Runs; i++) {
+        std::remove(argv[3]);
+        auto start = std::chrono::steady_clock::now();
+        pid_t pid;
+        if (posix_spawn(&pid, argv[1], &actions, nullptr, args.data(), environ) != 0) {
+            std::perror("cannot run the compiler");
+            return 1;
+        }
+        int status;
+        waitpid(pid, &status, 0);
+        auto end = std::chrono::steady_clock::now();
+        std::FILE* output = std::fopen(argv[3], "r");
+        if (!WIFEXITED(status) || WEXITSTATUS(status) != 0 || !output) {
+            std::fprintf(stderr, "the compiler failed or wrote no output\n");
+            return 1;
+        }
+        std::fclose(output);
+        if (i >= Warmup) times.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+    posix_spawn_file_actions_destroy(&actions);
+
+    std::sort(times.begin(), times.end());
+    double median = times[times.size() / 2];
+    std::printf("startup: min %.2f ms, median %.2f ms, max %.2f ms (budget %.0f ms)\n", times.front(), median,
+                times.back(), budget);
+    if (median > budget) {
+        std::fprintf(stderr, "startup regression: the median is over the budget\n");
+        return 1;
+    }
+    return 0;
+}
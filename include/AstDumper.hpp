@@ -11,6 +11,11 @@ class AstDumper : public AstNodesVisitor {
    public:
     void dumpAll(const AstNodePtrVector& nodes, const std::string& filePath);
 
+    /**
+     * @brief Dump a single node and its children to a stream.
+     */
+    void dumpNode(const AstNodeBase& node, std::ostream& os);
+
    protected:
     virtual void visit(const AstCompUnit& node) override;
     virtual void visit(const AstDecl& node) override;
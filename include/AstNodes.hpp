@@ -48,6 +48,15 @@ class AstNodeBase {
    public:
     virtual ~AstNodeBase() = default;
     virtual void accept(AstNodesVisitor &visitor) const = 0;
+
+    /**
+     * @brief The source line of the node, 0 if unknown.
+     */
+    int lineno() const { return _lineno; }
+    void setLineno(int lineno) { _lineno = lineno; }
+
+   private:
+    int _lineno = 0;
 };
 
 using AstNodePtr = std::unique_ptr<AstNodeBase>;
@@ -191,13 +200,22 @@ class AstFuncFParam : public AstNodeBase {
     AST_NODE
    public:
     AstFuncFParam(AstBTypePtr type, std::string id)
-        : _type(std::move(type)), _id(id) {}
+        : _type(std::move(type)), _id(id), _isArray(false) {}
+    /**
+     * @brief An array parameter. The first dimension is always omitted, so arrLens holds the rest.
+     */
+    AstFuncFParam(AstBTypePtr type, std::string id, std::vector<AstExpPtr> arrLens)
+        : _type(std::move(type)), _id(id), _isArray(true), _arrLens(std::move(arrLens)) {}
     const auto &type() const { return _type; }
     const auto &id() const { return _id; }
+    bool isArray() const { return _isArray; }
+    const auto &arrLens() const { return _arrLens; }
 
    private:
     AstBTypePtr _type;
     std::string _id;
+    bool _isArray;
+    std::vector<AstExpPtr> _arrLens;
 };
 
 class AstBlock : public AstNodeBase {
@@ -0,0 +1,66 @@
+#pragma once
+#include <llvm/ADT/Optional.h>
+#include <llvm/Support/CodeGen.h>
+#include <string>
+
+/**
+ * @brief Options that change the generated machine code.
+ */
+struct CodegenOptions {
+    // normalized target triple, the host's if empty
+    std::string triple;
+    std::string cpu = "generic";
+    // comma separated "+feature,-feature" list as understood by the target
+    std::string features;
+    llvm::Optional<llvm::Reloc::Model> relocModel;
+    llvm::Optional<llvm::CodeModel::Model> codeModel;
+    // emit DWARF line tables and variable locations
+    bool debugInfo = false;
+    // keep the frame pointer in every function, so profilers can walk the stack without unwind tables
+    bool framePointer = false;
+
+    /**
+     * @brief The target triple, the host's by default.
+     */
+    std::string targetTriple() const;
+
+    /**
+     * @brief Whether the code runs on the host, i.e. the target has the architecture of the host.
+     */
+    bool isHostTarget() const;
+
+    /**
+     * @brief Select the target triple and its default CPU (see defaultCPU()), unless keepCPU.
+     */
+    void setTriple(const std::string& name, bool keepCPU);
+
+    /**
+     * @brief The CPU whose scheduling model and extensions are used for a triple unless -mcpu says otherwise:
+     * the CPUs of the SysY reference boards for ARM and RISC-V, "generic" for the rest.
+     */
+    static std::string defaultCPU(const std::string& triple);
+
+    /**
+     * @brief Select the target CPU. "native" selects the host CPU and all of its features.
+     */
+    void setCPU(const std::string& name);
+
+    /**
+     * @brief Append target features, e.g. "+avx2,-fma".
+     */
+    void addFeatures(const std::string& attrs);
+
+    /**
+     * @brief Parse a relocation model name: static, pic, dynamic-no-pic, ropi, rwpi or ropi-rwpi.
+     *
+     * @return whether the name is valid
+     */
+    bool setRelocModel(const std::string& name);
+
+    /**
+     * @brief Parse a code model name: tiny, small, kernel, medium or large.
+     *
+     * @return whether the name is valid
+     */
+    bool setCodeModel(const std::string& name);
+};
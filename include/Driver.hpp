@@ -0,0 +1,129 @@
+#pragma once
+#include <string>
+#include <utility>
+#include <vector>
+#include <llvm/Passes/OptimizationLevel.h>
+#include "CodegenOptions.hpp"
+
+/**
+ * @brief What the compiler produces from a source file.
+ */
+enum Target {
+    TOKENS,
+    AST,
+    IR,
+    BC,
+    ASM,
+    OBJ,
+    EXE,
+    RUN
+};
+
+/**
+ * @brief Options of one compilation, shared by all files of a batch.
+ */
+struct DriverOptions {
+    Target target = EXE;
+    // runtime archive linked into executables
+    std::string runtimePath;
+    llvm::OptimizationLevel optLevel = llvm::OptimizationLevel::O0;
+    CodegenOptions codegenOptions;
+    // threads generating the partitions of one file, 0 to generate it as a whole
+    unsigned jobs = 0;
+    // directory of the compile cache, disabled if empty
+    std::string cacheDir;
+    // size cap of the compile cache in bytes, 0 for no cap
+    uint64_t cacheSizeLimit = 0;
+    // cache IR, assembly and objects function by function, see IrGenerator::outputIncremental()
+    bool incremental = false;
+    // the source is the whole program, see IrGenerator::annotateWholeProgram()
+    bool wholeProgram = true;
+    // profile written by the instrumented program, instrumentation disabled if empty
+    std::string profileGenerate;
+    // profile applied to the module, disabled if empty
+    std::string profileUse;
+    // source file named in debug info, the input file if empty
+    std::string sourceName;
+    // regular expressions of the passes whose optimization remarks are reported, see IrGenerator::reportRemarks()
+    std::string remarksPassed;
+    std::string remarksMissed;
+    std::string remarksAnalysis;
+    // generate x86-64 assembly straight from the AST, see FastBackend
+    bool fastBackend = false;
+};
+
+/**
+ * @brief Whether a file is LLVM IR (.ll) or bitcode (.bc) rather than SysY source.
+ */
+bool isIrFile(const std::string& path);
+
+/**
+ * @brief A parsed command line of the compiler.
+ */
+struct CommandLine {
+    DriverOptions options;
+    std::vector<std::string> inFilePaths;
+    // output file, or output directory in batch mode
+    std::string outFilePath;
+    std::string manifestPath;
+    // -j: threads generating the partitions of a single file, or files compiled at once in batch mode; 0 if not given
+    unsigned jobs = 0;
+    std::string serverSocket;
+    std::string clientSocket;
+
+    bool isBatch() const { return !manifestPath.empty() || inFilePaths.size() > 1; }
+};
+
+/**
+ * @brief Parse the arguments (without the program name) into cmd, keeping the defaults already set in it.
+ *
+ * @return whether the arguments are valid, errors are reported
+ */
+bool parseCommandLine(const std::vector<std::string>& args, CommandLine& cmd);
+
+/**
+ * @brief Compile what a parsed command line asks for, a single file or a batch.
+ */
+int runCommandLine(const CommandLine& cmd);
+
+/**
+ * @brief Compile one SysY source file.
+ *
+ * LLVM IR and bitcode inputs skip the front end and the module stages, and are only optimized and compiled.
+ * IR, bitcode, assembly and object files (and the object of an executable) are looked up in the compile cache first,
+ * keyed by the normalized source and every option that affects the generated code.
+ *
+ * @return the exit code of the compiler, or of the program for RUN
+ */
+int compileFile(const DriverOptions& options, const std::string& inFilePath, const std::string& outFilePath);
+
+/**
+ * @brief Evict the least recently used entries of the compile cache until it fits its size cap.
+ */
+void pruneCompileCache(const DriverOptions& options);
+
+/**
+ * @brief Compile many (input, output) files concurrently, every file in its own LLVMContext.
+ *
+ * The messages of a file are collected and only written out if it fails, so they never interleave.
+ *
+ * @param threads number of files compiled at the same time, 0 for all hardware threads
+ * @return 0 if every file compiled, 1 otherwise
+ */
+int compileBatch(const DriverOptions& options, const std::vector<std::pair<std::string, std::string>>& files,
+                 unsigned threads);
+
+/**
+ * @brief Read a batch manifest: one "input [output]" per line, empty lines and lines starting with '#' are skipped.
+ *
+ * A missing output is derived from the input, see batchOutputPath().
+ *
+ * @return whether the manifest could be read
+ */
+bool readBatchManifest(const std::string& path, Target target, const std::string& outDir,
+                       std::vector<std::pair<std::string, std::string>>& files);
+
+/**
+ * @brief The output of an input in a batch: the input with the extension of the target, placed in outDir if given.
+ */
+std::string batchOutputPath(const std::string& inFilePath, Target target, const std::string& outDir);
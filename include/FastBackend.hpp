@@ -0,0 +1,142 @@
+#pragma once
+#include "AstNodesVisitor.hpp"
+#include "AstNodes.hpp"
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/**
+ * @brief A baseline backend generating x86-64 assembly (GNU syntax, SysV ABI) straight from the AST, without LLVM.
+ *
+ * Code is generated like for a stack machine: every expression leaves its value in %eax (an address in %rax),
+ * and the operands waiting for it are pushed on the stack. Every variable lives in the stack frame. The code is
+ * slow, but it is generated in a single pass over the AST.
+ */
+class FastBackend : public AstNodesVisitor {
+   public:
+    explicit FastBackend(const AstNodePtrVector& compUnits);
+
+    /**
+     * @brief Write the assembly of the program to a file.
+     */
+    bool output(const std::string& path);
+
+    void visit(const AstCompUnit&) override;
+    void visit(const AstDecl&) override;
+    void visit(const AstBType&) override;
+    void visit(const AstVarDecl&) override;
+    void visit(const AstVarDef&) override;
+    void visit(const AstInitVal&) override;
+    void visit(const AstFuncDef&) override;
+    void visit(const AstFuncType&) override;
+    void visit(const AstFuncFParams&) override;
+    void visit(const AstFuncFParam&) override;
+    void visit(const AstBlock&) override;
+    void visit(const AstBlockItem&) override;
+    void visit(const AstAssignStmt&) override;
+    void visit(const AstExpStmt&) override;
+    void visit(const AstBlockStmt&) override;
+    void visit(const AstIfStmt&) override;
+    void visit(const AstWhileStmt&) override;
+    void visit(const AstBreakStmt&) override;
+    void visit(const AstContinueStmt&) override;
+    void visit(const AstReturnStmt&) override;
+    void visit(const AstExp&) override;
+    void visit(const AstCond&) override;
+    void visit(const AstLVal&) override;
+    void visit(const AstPrimaryExp&) override;
+    void visit(const AstNumber&) override;
+    void visit(const AstBinaryExp&) override;
+    void visit(const AstUnaryExp&) override;
+    void visit(const AstFuncRParams&) override;
+    void visit(const AstFuncCall&) override;
+
+   private:
+    /**
+     * @brief A variable: a global, or a slot in the stack frame.
+     */
+    struct Symbol {
+        std::string global;     // label of a global, empty for locals
+        int offset = 0;         // %rbp relative address of a local
+        std::vector<int> dims;  // array dimensions, the first one is 0 for array parameters
+        bool pointer = false;   // the slot holds the address of the array (array parameters)
+    };
+
+    struct Function {
+        size_t paramCount;
+        std::string symbol;
+        bool external;  // defined by the runtime
+    };
+
+    /**
+     * @brief Jump targets of 'continue' and 'break' in an enclosing loop.
+     */
+    struct LoopLabels {
+        std::string continueLabel;
+        std::string breakLabel;
+    };
+
+    void emit(const std::string& inst) { _text << "\t" << inst << "\n"; }
+    void label(const std::string& name) { _text << name << ":\n"; }
+    std::string newLabel() { return ".L" + std::to_string(_labelCount++); }
+
+    /**
+     * @brief Push %rax / pop into a register, keeping track of the stack depth for the alignment of calls.
+     */
+    void push();
+    void pop(const std::string& reg);
+
+    /**
+     * @brief Reserve a stack slot and return its %rbp relative address.
+     */
+    int allocate(int size, int align);
+
+    const Symbol& lookupSymbol(const std::string& name) const;
+
+    /**
+     * @brief Evaluate a constant expression.
+     *
+     * @return whether the expression is constant
+     */
+    bool evalConst(const AstNodeBase& node, int& value) const;
+
+    std::vector<int> evalArrayLens(const std::vector<AstExpPtr>& arrLens) const;
+
+    /**
+     * @brief Assign the expressions of an initializer list to the elements of a flattened array (row-major).
+     */
+    void flattenInitVal(const AstInitVal& initVal, const std::vector<int>& dims, size_t depth, size_t begin,
+                        std::vector<const AstNodeBase*>& elems) const;
+
+    void defineGlobal(const AstVarDef& def);
+
+    /**
+     * @brief Leave the address of an element or a sub-array in %rax.
+     */
+    void lvalAddress(const AstLVal& node, const Symbol& symbol);
+
+    /**
+     * @brief Generate a condition as jumps to trueLabel and falseLabel, short-circuiting '&&' and '||'.
+     */
+    void condjump(const AstNodeBase& node, const std::string& trueLabel, const std::string& falseLabel);
+
+    /**
+     * @brief Generate a comparison, setting the flags for the jump or set instruction of the returned condition code.
+     *
+     * @return the condition code, empty if op is not a comparison
+     */
+    std::string compare(const AstBinaryExp& node);
+
+    void generate(const AstNodeBase& node) { node.accept(*this); }
+
+    const AstNodePtrVector& _compUnits;
+    std::ostringstream _text, _data, _bss;
+    std::vector<std::map<std::string, Symbol>> _scopes;
+    std::map<std::string, Function> _functions;
+    std::vector<LoopLabels> _loops;
+    std::string _retLabel;
+    int _frameSize = 0;
+    int _depth = 0;  // bytes pushed below the frame
+    unsigned _labelCount = 0;
+};
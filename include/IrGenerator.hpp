@@ -1,10 +1,13 @@
 #pragma once
 #include "AstNodesVisitor.hpp"
 #include "AstNodes.hpp"
+#include "CodegenOptions.hpp"
+#include "Runtime.hpp"
 #include <llvm/ADT/APSInt.h>
 #include <llvm/ADT/STLExtras.h>
 #include <llvm/IR/BasicBlock.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/DIBuilder.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/IRBuilder.h>
@@ -12,7 +15,9 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/Module.h>
+#include <llvm/Passes/OptimizationLevel.h>
 #include <llvm/IR/Type.h>
+#include <llvm/IR/ValueHandle.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/MC/TargetRegistry.h>
 #include <llvm/Support/TargetSelect.h>
@@ -24,10 +29,24 @@
 #include <llvm/Support/raw_os_ostream.h>
 #include <map>
 #include <memory>
+#include <set>
 
 class IrGenerator : public AstNodesVisitor {
    public:
-    explicit IrGenerator(AstNodePtrVector compUnits);
+    /**
+     * @brief Construct for the AST of a source file.
+     *
+     * @param sourcePath the source file, which debug info refers to
+     */
+    explicit IrGenerator(AstNodePtrVector compUnits, CodegenOptions options = CodegenOptions(),
+                         const std::string& sourcePath = "");
+
+    /**
+     * @brief Construct with a module loaded from an LLVM IR (.ll) or bitcode (.bc) file, to be optimized and compiled.
+     *
+     * The module keeps its target triple if it has one.
+     */
+    IrGenerator(const std::string& irFilePath, CodegenOptions options);
 
     void codegen();
 
@@ -40,16 +59,106 @@ class IrGenerator : public AstNodesVisitor {
         _module->print(of, nullptr);
     }
 
-    void output(const std::string& path, llvm::CodeGenFileType fileType);
+    /**
+     * @brief Annotate the module as a whole program, whose only entry is main().
+     *
+     * All other functions and the globals get internal linkage, the functions the fast calling convention.
+     * Every function is nounwind, and from its memory accesses, loops and callees it is inferred to be
+     * readnone/readonly, norecurse and willreturn where possible.
+     */
+    void annotateWholeProgram();
+
+    /**
+     * @brief Optimize the globals of a whole program, after annotateWholeProgram().
+     *
+     * Globals that are never written after their initialization become constant, and scalar globals that only a
+     * non-recursive main() accesses become locals of main(), which mem2reg can keep in registers.
+     */
+    void optimizeGlobals();
+
+    /**
+     * @brief Output the module as LLVM bitcode to file.
+     *
+     * @return whether the file was written
+     */
+    bool writeBitcode(const std::string& path) const;
+
+    /**
+     * @brief Count how often every function is entered and every conditional branch goes either way.
+     *
+     * main() registers the counters with the runtime, which writes (or merges) them into profilePath when the
+     * program exits. Must run before optimization, at the same point as applyProfile().
+     */
+    void instrumentProfile(const std::string& profilePath);
+
+    /**
+     * @brief Attach the function entry counts and branch weights of a profile written by an instrumented build.
+     *
+     * A profile of another program is ignored with a warning.
+     *
+     * @return false if the profile cannot be read
+     */
+    bool applyProfile(const std::string& profilePath);
+
+    /**
+     * @brief Report the optimization remarks of the passes whose names match a regular expression, like clang's
+     * -Rpass. Empty expressions report nothing.
+     *
+     * Call before codegen(): the remarks are located at the source lines even without debug info.
+     *
+     * @param passed passes reporting what they did, e.g. "loop-vectorize"
+     * @param missed passes reporting what they could not do
+     * @param analysis passes reporting why, e.g. the reason a loop was not vectorized
+     */
+    void reportRemarks(const std::string& passed, const std::string& missed, const std::string& analysis);
+
+    /**
+     * @brief Run the new pass manager's default module pipeline over the generated module.
+     *
+     * @param level optimization level, O0 only runs the passes required for correctness
+     */
+    void optimize(llvm::OptimizationLevel level);
 
     /**
-     * @brief Manually add an extern function for SysY to use runtime libraries.
+     * @brief Generate machine code for the module.
+     *
+     * With jobs the module is split into a fixed number of partitions, which are compiled on that many threads
+     * and then joined in partition order, so the result is the same for any number of jobs.
      *
-     * @param name the name of the function
-     * @param retType return type of the function
-     * @param params parameter types of the function
+     * @param fileType assembly or object file
+     * @param jobs threads compiling the partitions, 0 to generate the module as a whole
+     * @return whether the file was written
      */
-    void addExternFunction(const char* name, llvm::Type* retType, const std::vector<llvm::Type*>& params);
+    bool output(const std::string& path, llvm::CodeGenFileType fileType, unsigned jobs = 0);
+
+    /**
+     * @brief Optimize and generate code function by function, reusing the functions that did not change.
+     *
+     * Every function definition is a part keyed by its AST, the signatures of its callees and the global
+     * declarations, and all global variables form one more part keyed by their IR. Only parts missing from the
+     * cache are optimized and compiled, then all parts are joined into one file. Functions are optimized on
+     * their own, so nothing is inlined across functions.
+     *
+     * @param fileType assembly or object file, None for optimized IR
+     * @param settings everything else that affects the generated code, e.g. compiler version and options
+     * @return whether the file was written
+     */
+    bool outputIncremental(const std::string& path, llvm::Optional<llvm::CodeGenFileType> fileType,
+                           llvm::OptimizationLevel level, const std::string& cacheDir, const std::string& settings);
+
+    /**
+     * @brief Run the module's main() in-process with the ORC JIT, bound to the SysY runtime linked into the compiler.
+     *
+     * The module is handed over to the JIT, so nothing else can be generated from it afterwards.
+     *
+     * @return the exit code returned by main(), or 1 if the JIT fails
+     */
+    int run();
+
+    /**
+     * @brief Declare a function of the runtime, with the attributes of its array parameters.
+     */
+    void addExternFunction(const RuntimeFunction& runtime);
 
    public:  // visitor methods
     void visit(const AstCompUnit&) override;
@@ -85,22 +194,248 @@ class IrGenerator : public AstNodesVisitor {
    private:
     template <class AstT>
     llvm::Value* codegen(const AstT& node) {
+        if (!_diSubprogram || node.lineno() == 0) {
+            node.accept(*this);
+            return _ret;
+        }
+        // instructions are located at the innermost node they are generated for
+        auto outerLoc = _builder->getCurrentDebugLocation();
+        _builder->SetCurrentDebugLocation(llvm::DILocation::get(*_context, node.lineno(), 0, _diSubprogram));
         node.accept(*this);
+        _builder->SetCurrentDebugLocation(outerLoc);
         return _ret;
     }
 
     void ret(llvm::Value* val) { _ret = val; }
-    llvm::AllocaInst* createEntryBlockAlloca(llvm::Function* func,
+
+    /**
+     * @brief Get the target machine for the module's triple (the host's by default) with the codegen options, and set
+     * triple & data layout on the module.
+     *
+     * Only the target of the triple is initialized, once per process, and target machines are reused by later modules on
+     * the same thread.
+     */
+    void initTarget();
+
+    /**
+     * @brief Create a new target machine from the module triple and the codegen options.
+     */
+    std::unique_ptr<llvm::TargetMachine> createTargetMachine() const;
+
+    /**
+     * @brief The conditional branches of every defined function, in the order their profile counters are laid out.
+     *
+     * Every function has an entry counter, followed by a taken and a not taken counter per branch.
+     */
+    std::vector<std::pair<llvm::Function*, std::vector<llvm::BranchInst*>>> profileSites() const;
+
+    /**
+     * @brief Identify the control flow a profile was collected for.
+     */
+    static uint64_t profileChecksum(const std::vector<std::pair<llvm::Function*, std::vector<llvm::BranchInst*>>>& sites);
+
+    /**
+     * @brief Run the optimization pipeline of a level on a module.
+     */
+    void optimizeModule(llvm::Module& module, llvm::OptimizationLevel level);
+
+    /**
+     * @brief Join generated partitions into one file: IR is linked, assembly concatenated and objects combined.
+     *
+     * @param fileType assembly or object file, None for bitcode partitions written as IR
+     */
+    bool joinPartitions(const std::string& path, llvm::Optional<llvm::CodeGenFileType> fileType,
+                        const std::vector<llvm::SmallVector<char, 0>>& parts);
+
+    /**
+     * @brief Split the module into partitions and generate code for them on a pool of jobs threads.
+     *
+     * @return the generated files, in partition order
+     */
+    std::vector<llvm::SmallVector<char, 0>> emitPartitions(llvm::CodeGenFileType fileType, unsigned jobs);
+
+    /**
+     * @brief Create the debug info compile unit of the source file.
+     */
+    void createDebugCompileUnit();
+
+    /**
+     * @brief Get the debug info type of int or an array of int.
+     */
+    llvm::DIType* getDebugType(llvm::Type* type);
+
+    /**
+     * @brief Describe a local variable or parameter to the debugger.
+     *
+     * @param argNo position of a parameter, starting from 1, or 0 for a local variable
+     * @return the variable, nullptr without debug info
+     */
+    llvm::DILocalVariable* createDebugVariable(const std::string& name, llvm::DIType* type, unsigned argNo = 0);
+
+    /**
+     * @brief Tell the debugger the value a variable is assigned at the current location.
+     */
+    void emitDebugValue(llvm::DILocalVariable* var, llvm::Value* value);
+
+    llvm::AllocaInst* createEntryBlockAlloca(llvm::Function* func, llvm::Type* type,
                                              const std::string& varName) const;
 
+    /**
+     * @brief Generate a condition as branches to trueBB and falseBB.
+     *
+     * '&&', '||' and '!' are lowered into control flow, so the right operand only runs when needed and
+     * nested conditions jump straight to the final targets.
+     */
+    void condgen(const AstNodeBase& node, llvm::BasicBlock* trueBB, llvm::BasicBlock* falseBB);
+
+    /**
+     * @brief Emit the i1 comparison of a relational or equality operator.
+     *
+     * @return the comparison, or nullptr if op is not a comparison
+     */
+    llvm::Value* createCompare(BinaryOp op, llvm::Value* lhs, llvm::Value* rhs);
+
+    /**
+     * @brief A named entity in scope: either a local scalar kept in SSA form, or an object in memory.
+     */
+    struct Symbol {
+        unsigned var = 0;             // SSA variable id, used when addr is nullptr
+        llvm::Value* addr = nullptr;  // address of the object in memory
+        llvm::Type* type = nullptr;   // type of the object at addr
+        bool decayed = false;         // addr points to the first of several objects (array parameters)
+    };
+
+    /**
+     * @brief Create a distinct llvm.loop metadata node for a loop latch.
+     *
+     * @param mustProgress whether the loop may be assumed to terminate (C11 6.8.5p6)
+     */
+    llvm::MDNode* createLoopID(bool mustProgress);
+
+    /**
+     * @brief Look up a symbol by name in the current scope.
+     * @throw std::runtime_error if the name is not declared
+     */
+    const Symbol& lookupSymbol(const std::string& name) const;
+
+    /**
+     * @brief Evaluate the lengths of an array declaration, which must be constant expressions.
+     */
+    std::vector<uint64_t> evalArrayLens(const std::vector<AstExpPtr>& arrLens);
+
+    /**
+     * @brief Get the nested array type [d0 x [d1 x ... i32]], or i32 if dims is empty.
+     */
+    llvm::Type* getArrayType(const std::vector<uint64_t>& dims) const;
+
+    /**
+     * @brief Flatten a braced initializer into row-major element order.
+     *
+     * A nested list initializes the largest sub-array aligned at the current position.
+     *
+     * @param elems one slot per element, left nullptr for elements initialized to zero
+     */
+    void flattenInitVal(const AstInitVal& initVal, const std::vector<uint64_t>& dims, size_t depth,
+                        size_t begin, std::vector<const AstNodeBase*>& elems);
+
+    /**
+     * @brief Generate the element values of an array initializer in row-major order.
+     *
+     * @return one value per element, nullptr for elements initialized to zero
+     */
+    std::vector<llvm::Value*> codegenArrayInit(const std::vector<uint64_t>& dims, const AstInitVal& initVal);
+
+    /**
+     * @brief Build a constant of an i32 (nested) array type from its row-major elements.
+     *
+     * All-zero sub-arrays become zeroinitializer and the innermost rows become constant data arrays.
+     *
+     * @param elems the elements, nullptr stands for zero
+     */
+    llvm::Constant* getConstantArray(llvm::Type* type, llvm::ArrayRef<llvm::Value*> elems) const;
+
+    /**
+     * @brief Initialize a local array with one memset/memcpy and stores for the remaining elements.
+     */
+    void initLocalArray(llvm::AllocaInst* array, const std::vector<uint64_t>& dims, const AstInitVal& initVal);
+
+    /**
+     * @brief Define a global variable with a constant initializer.
+     */
+    void defineGlobal(const AstVarDef& def);
+
+    /**
+     * @brief Get the address of the element or sub-array an lvalue designates.
+     *
+     * @param type set to the type of the object at the returned address
+     */
+    llvm::Value* lvalAddress(const AstLVal& node, llvm::Type*& type);
+
+#pragma region SSA construction
+    /**
+     * SSA values are built directly while generating code, following
+     * Braun et al., "Simple and Efficient Construction of Static Single Assignment Form" (CC 2013).
+     * Each local scalar is a variable id; its current definition is tracked per basic block
+     * and phis are only placed when a read reaches a join point.
+     */
+
+    /**
+     * @brief Create a new SSA variable and return its id.
+     */
+    unsigned newVariable(const std::string& name, llvm::Type* type);
+
+    /**
+     * @brief Record value as the current definition of var in block.
+     */
+    void writeVariable(unsigned var, llvm::BasicBlock* block, llvm::Value* value);
+
+    /**
+     * @brief Get the current definition of var in block, adding phis when needed.
+     */
+    llvm::Value* readVariable(unsigned var, llvm::BasicBlock* block);
+    llvm::Value* readVariableRecursive(unsigned var, llvm::BasicBlock* block);
+    llvm::Value* addPhiOperands(unsigned var, llvm::PHINode* phi);
+    llvm::Value* tryRemoveTrivialPhi(llvm::PHINode* phi);
+
+    /**
+     * @brief Mark that all predecessors of block are known, and complete its pending phis.
+     */
+    void sealBlock(llvm::BasicBlock* block);
+#pragma endregion
+
    private:
     AstNodePtrVector _compUnits;
+    CodegenOptions _options;
     std::unique_ptr<llvm::LLVMContext> _context;
     std::unique_ptr<llvm::IRBuilder<>> _builder;
     std::unique_ptr<llvm::Module> _module;
-    std::map<std::string, llvm::AllocaInst*> _namedValues;
-    std::unique_ptr<llvm::legacy::FunctionPassManager> _fpm;
+    std::shared_ptr<llvm::TargetMachine> _targetMachine;
+    std::map<std::string, Symbol> _namedValues;
+
+    // debug info, only with CodegenOptions::debugInfo
+    std::unique_ptr<llvm::DIBuilder> _diBuilder;
+    llvm::DICompileUnit* _diCompileUnit = nullptr;
+    llvm::DISubprogram* _diSubprogram = nullptr;  // of the function being generated
+
+    /**
+     * @brief Jump targets of 'continue' and 'break' in an enclosing loop.
+     */
+    struct LoopContext {
+        llvm::BasicBlock* continueBB;
+        llvm::BasicBlock* breakBB;
+    };
+    std::vector<LoopContext> _loops;
     llvm::Value* _ret;
     llvm::BasicBlock* _retBB;
-    llvm::AllocaInst* _retAlloca;
+    unsigned _retVar;
+
+    struct Variable {
+        std::string name;
+        llvm::Type* type;
+        llvm::DILocalVariable* debugVar = nullptr;
+    };
+    std::vector<Variable> _variables;
+    std::map<llvm::BasicBlock*, std::map<unsigned, llvm::WeakTrackingVH>> _currentDef;
+    std::map<llvm::BasicBlock*, std::map<unsigned, llvm::PHINode*>> _incompletePhis;
+    std::set<llvm::BasicBlock*> _sealedBlocks;
 };
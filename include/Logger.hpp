@@ -2,17 +2,29 @@
 #include <iostream>
 #include <memory>
 
+/**
+ * @brief Diagnostics of the compiler, one logger per thread.
+ */
 class Logger {
    public:
     Logger() = default;
 
     static Logger &getInstance() {
-        static Logger instance;
+        // jobs on different threads must not interleave their messages
+        thread_local Logger instance;
         return instance;
     }
 
     std::ostream &log();
     std::ostream &err();
+
+    /**
+     * @brief Write the messages of this thread to another stream, nullptr restores stderr.
+     */
+    void redirect(std::ostream *out) { _out = out ? out : &std::cerr; }
+
+   private:
+    std::ostream *_out = &std::cerr;
 };
 
 inline Logger &logger() { return Logger::getInstance(); }
@@ -98,11 +98,12 @@ class Parser {
     ParsingError error(const std::string& msg);
 
     /**
-     * @brief Construct an AST node
+     * @brief Construct an AST node, located at the line of the last token it consumed
      */
     template <typename T, typename... Args>
     std::unique_ptr<T> makeAstNode(Args&&... args) {
         auto ast = std::make_unique<T>(std::forward<Args>(args)...);
+        ast->setLineno(_tokenIter == _tokens.begin() ? curToken().getLineno() : std::prev(_tokenIter)->getLineno());
         return ast;
     }
 
@@ -0,0 +1,42 @@
+#pragma once
+#include <string>
+#include <vector>
+
+/**
+ * @brief Types in the signatures of the runtime functions.
+ */
+enum class RuntimeType {
+    VOID,
+    INT,
+    // an int array the function only reads
+    INT_ARRAY_IN,
+    // an int array the function only writes
+    INT_ARRAY_OUT
+};
+
+/**
+ * @brief A function of the SysY runtime (sylib), callable from every program.
+ */
+struct RuntimeFunction {
+    // name in SysY source
+    const char* name;
+    // name of the definition in the runtime
+    const char* symbol;
+    RuntimeType retType;
+    std::vector<RuntimeType> params;
+    // called without arguments in SysY source, the runtime function takes the line of the call instead
+    bool passesLine;
+    // the definition linked into the compiler, for -run
+    void* address;
+};
+
+/**
+ * @brief The complete runtime interface, as declared in sylib.h. The floating point functions and putf are left
+ * out, SysY programs here have no float type or strings.
+ */
+const std::vector<RuntimeFunction>& runtimeFunctions();
+
+/**
+ * @brief The runtime function called by a name in SysY source, nullptr if there is none.
+ */
+const RuntimeFunction* findRuntimeFunction(const std::string& name);
@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "Driver.hpp"
+
+/*
+ * Protocol between client and server over a unix stream socket, one request per connection.
+ * Every message is a sequence of frames, a frame is a 4-byte big-endian length followed by that many bytes.
+ *
+ *   request:  [arguments joined by '\0'] [source]
+ *   response: [exit code in decimal] [diagnostics] [output file]
+ */
+
+/**
+ * @brief Serve compile requests on a unix socket until the process is killed.
+ *
+ * Targets stay initialized and the target machines of the worker threads are reused between requests.
+ *
+ * @param runtimePath default runtime archive for executables
+ */
+int runServer(const std::string& socketPath, const std::string& runtimePath);
+
+/**
+ * @brief Send a single file compilation to the server and write its output like the normal CLI would.
+ *
+ * Batches, -run and failures to reach the server fall back to compiling in this process.
+ *
+ * @param args the arguments cmd was parsed from
+ */
+int runClient(const CommandLine& cmd, const std::vector<std::string>& args);
@@ -1,27 +1,289 @@
+#include <errno.h>
+#include <limits.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
 #include "sylib.h"
-/* Input & output functions */
+/* Input & output functions
+ *
+ * stdin and stdout are buffered here and accessed with read() and write() only. Numbers are parsed and formatted
+ * by hand with the semantics of scanf("%d") and printf("%d"), 8 digits at a time where possible. The output is
+ * written when the buffer is full, before stdin is read, at exit and, if stdout is a terminal, after every line. */
+#define IO_BUFFER_SIZE (1 << 16)
+
+static char in_buf[IO_BUFFER_SIZE];
+static char* in_pos = in_buf;
+static char* in_end = in_buf;
+static int in_eof;
+
+static char out_buf[IO_BUFFER_SIZE];
+static int out_len;
+static int out_line_buffered;
+
+void __sysy_flush() {
+    int done = 0;
+    while (done < out_len) {
+        ssize_t n = write(1, out_buf + done, out_len - done);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        done += n;
+    }
+    out_len = 0;
+}
+
+__attribute__((constructor)) static void io_init() {
+    out_line_buffered = isatty(1);
+    atexit(__sysy_flush);
+}
+
+/* Refill the input buffer, return 0 at the end of the input */
+static int in_fill() {
+    if (in_eof) return 0;
+    /* an interactive program shows its prompt before waiting for the answer */
+    __sysy_flush();
+    ssize_t n;
+    do {
+        n = read(0, in_buf, IO_BUFFER_SIZE);
+    } while (n < 0 && errno == EINTR);
+    if (n <= 0) {
+        in_eof = 1;
+        return 0;
+    }
+    in_pos = in_buf;
+    in_end = in_buf + n;
+    return 1;
+}
+
+/* The next input character without consuming it, -1 at the end of the input */
+static inline int in_peek() {
+    if (in_pos == in_end && !in_fill()) return -1;
+    return (unsigned char)*in_pos;
+}
+
+static inline int is_digit(int c) { return c >= '0' && c <= '9'; }
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+/* Whether the 8 bytes (first character in the lowest byte) are all decimal digits */
+static inline int swar_all_digits(uint64_t chunk) {
+    return ((chunk & 0xF0F0F0F0F0F0F0F0ull) | (((chunk + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) ==
+           0x3333333333333333ull;
+}
+
+/* The value of 8 decimal digits, first character in the lowest byte */
+static inline uint64_t swar_parse8(uint64_t chunk) {
+    chunk -= 0x3030303030303030ull;
+    chunk = chunk * 10 + (chunk >> 8);
+    return (((chunk & 0x000000FF000000FFull) * (100 + (1000000ull << 32))) +
+            (((chunk >> 16) & 0x000000FF000000FFull) * (1 + (10000ull << 32)))) >>
+           32;
+}
+#define HAVE_SWAR 1
+#endif
+
+/* scanf("%d"): skip white space, then an optional sign and decimal digits. The value is converted like strtol
+ * (saturated to the range of long) and then truncated to int. Returns 0 if there is no number. */
 int getint() {
-    int t;
-    scanf("%d", &t);
-    return t;
+    int c;
+    while ((c = in_peek()) == ' ' || (c >= '\t' && c <= '\r')) in_pos++;
+    int negative = 0;
+    if (c == '-' || c == '+') {
+        negative = c == '-';
+        in_pos++;
+        c = in_peek();
+    }
+    if (!is_digit(c)) return 0;
+
+    /* |LONG_MIN|, the largest magnitude strtol returns */
+    const uint64_t limit = (uint64_t)LONG_MAX + 1;
+    uint64_t value = 0;
+    int saturated = 0;
+    for (;;) {
+#ifdef HAVE_SWAR
+        while (in_end - in_pos >= 8) {
+            uint64_t chunk;
+            memcpy(&chunk, in_pos, 8);
+            if (!swar_all_digits(chunk)) break;
+            uint64_t digits = swar_parse8(chunk);
+            if (value > (limit - digits) / 100000000) saturated = 1;
+            value = value * 100000000 + digits;
+            in_pos += 8;
+        }
+#endif
+        if (!is_digit(c = in_peek())) break;
+        if (value > (limit - (c - '0')) / 10) saturated = 1;
+        value = value * 10 + (c - '0');
+        in_pos++;
+    }
+    if (saturated || (!negative && value == limit)) value = negative ? limit : limit - 1;
+    return (int)(unsigned)(negative ? 0 - value : value);
 }
 int getch() {
-    char c;
-    scanf("%c", &c);
-    return (int)c;
+    if (in_peek() < 0) return -1;
+    /* scanf("%c") into a char */
+    return (char)*in_pos++;
 }
 int getarray(int a[]) {
-    int n;
-    scanf("%d", &n);
-    for (int i = 0; i < n; i++) scanf("%d", &a[i]);
+    int n = getint();
+    for (int i = 0; i < n; i++) a[i] = getint();
     return n;
 }
-void putint(int a) { printf("%d", a); }
-void putch(int a) { printf("%c", a); }
+
+static inline void out_reserve(int len) {
+    if (out_len + len > IO_BUFFER_SIZE) __sysy_flush();
+}
+
+/* printf("%d") into the output buffer, which has room for it */
+static inline void out_int(int a) {
+    char digits[16];
+    char* p = digits + sizeof(digits);
+    unsigned u = a < 0 ? 0u - (unsigned)a : (unsigned)a;
+    do {
+        *--p = '0' + u % 10;
+        u /= 10;
+    } while (u);
+    if (a < 0) *--p = '-';
+    int len = digits + sizeof(digits) - p;
+    memcpy(out_buf + out_len, p, len);
+    out_len += len;
+}
+
+void putint(int a) {
+    out_reserve(11);
+    out_int(a);
+}
+void putch(int a) {
+    out_reserve(1);
+    out_buf[out_len++] = (char)a;
+    if (out_line_buffered && (char)a == '\n') __sysy_flush();
+}
 void putarray(int n, int a[]) {
-    printf("%d:", n);
-    for (int i = 0; i < n; i++) printf(" %d", a[i]);
-    printf("\n");
-}
\ No newline at end of file
+    out_reserve(12);
+    out_int(n);
+    out_buf[out_len++] = ':';
+    for (int i = 0; i < n; i++) {
+        out_reserve(12);
+        out_buf[out_len++] = ' ';
+        out_int(a[i]);
+    }
+    putch('\n');
+}
+/* Timing */
+#define TIMER_MAX_DEPTH 64
+#define TIMER_MAX_REGIONS 1024
+
+struct timer_region {
+    int start_line, stop_line;
+    int count;
+    long long ns;
+};
+static struct timer_region timer_regions[TIMER_MAX_REGIONS];
+static int timer_region_count;
+static struct {
+    int line;
+    long long ns;
+} timer_stack[TIMER_MAX_DEPTH];
+static int timer_depth;
+
+static long long timer_now() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000000000ll + ts.tv_nsec;
+}
+
+static void timer_print(const char* name, long long ns, int count) {
+    long long us = ns / 1000;
+    fprintf(stderr, "%s: %lldH-%lldM-%lldS-%lldus", name, us / 3600000000ll, us / 60000000 % 60, us / 1000000 % 60,
+            us % 1000000);
+    if (count > 1) fprintf(stderr, " (%d times)", count);
+    fputc('\n', stderr);
+}
+
+static void timer_report() {
+    long long total = 0;
+    for (int i = 0; i < timer_region_count; i++) {
+        struct timer_region* region = &timer_regions[i];
+        char name[32];
+        snprintf(name, sizeof(name), "Timer@%04d-%04d", region->start_line, region->stop_line);
+        timer_print(name, region->ns, region->count);
+        total += region->ns;
+    }
+    timer_print("TOTAL", total, 1);
+}
+
+void _sysy_starttime(int lineno) {
+    static int registered;
+    if (!registered) {
+        registered = 1;
+        atexit(timer_report);
+    }
+    if (timer_depth == TIMER_MAX_DEPTH) {
+        fprintf(stderr, "starttime() at line %d: more than %d nested timers\n", lineno, TIMER_MAX_DEPTH);
+        return;
+    }
+    timer_stack[timer_depth].line = lineno;
+    timer_stack[timer_depth].ns = timer_now();
+    timer_depth++;
+}
+void _sysy_stoptime(int lineno) {
+    long long now = timer_now();
+    if (timer_depth == 0) {
+        fprintf(stderr, "stoptime() at line %d without starttime()\n", lineno);
+        return;
+    }
+    timer_depth--;
+    int start_line = timer_stack[timer_depth].line;
+    int i = 0;
+    while (i < timer_region_count && (timer_regions[i].start_line != start_line || timer_regions[i].stop_line != lineno)) i++;
+    if (i == TIMER_MAX_REGIONS) return;
+    if (i == timer_region_count) {
+        timer_regions[timer_region_count++] = (struct timer_region){start_line, lineno, 0, 0};
+    }
+    timer_regions[i].count++;
+    timer_regions[i].ns += now - timer_stack[timer_depth].ns;
+}
+
+/* Profile of an instrumented program */
+static long long* prof_counters;
+static int prof_size;
+static long long prof_checksum;
+static const char* prof_path;
+
+void __sysy_prof_dump() {
+    if (!prof_counters) return;
+    /* runs of the same program add up */
+    FILE* f = fopen(prof_path, "r");
+    if (f) {
+        unsigned long long checksum;
+        int n;
+        if (fscanf(f, "checksum %llx counters %d", &checksum, &n) == 2 && (long long)checksum == prof_checksum &&
+            n == prof_size) {
+            for (int i = 0; i < n; i++) {
+                long long c;
+                if (fscanf(f, "%lld", &c) != 1) break;
+                prof_counters[i] += c;
+            }
+        }
+        fclose(f);
+    }
+    f = fopen(prof_path, "w");
+    if (!f) {
+        fprintf(stderr, "cannot write profile %s\n", prof_path);
+        prof_counters = NULL;
+        return;
+    }
+    fprintf(f, "checksum %llx\ncounters %d\n", (unsigned long long)prof_checksum, prof_size);
+    for (int i = 0; i < prof_size; i++) fprintf(f, "%lld\n", prof_counters[i]);
+    fclose(f);
+    prof_counters = NULL;
+}
+void __sysy_prof_register(long long counters[], int n, long long checksum, const char* path) {
+    prof_counters = counters;
+    prof_size = n;
+    prof_checksum = checksum;
+    prof_path = path;
+    atexit(__sysy_prof_dump);
+}
@@ -7,5 +7,19 @@
 /* Input & output functions */
 int getint(), getch(), getarray(int a[]);
 void putint(int a), putch(int a), putarray(int n, int a[]);
+/* Write the buffered output now */
+void __sysy_flush();
+
+/* Timing: the time between starttime() and stoptime() is summed per region (the lines of the two calls), and the
+ * regions are reported on stderr at exit. Regions may nest. */
+#define starttime() _sysy_starttime(__LINE__)
+#define stoptime() _sysy_stoptime(__LINE__)
+void _sysy_starttime(int lineno);
+void _sysy_stoptime(int lineno);
+
+/* Profile of an instrumented program (-fprofile-generate), written to path at exit */
+void __sysy_prof_register(long long counters[], int n, long long checksum, const char* path);
+/* Write the profile now instead of at exit, e.g. before the counters go away */
+void __sysy_prof_dump();
 
 #endif
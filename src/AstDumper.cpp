@@ -21,6 +21,13 @@ void AstDumper::dumpAll(const AstNodePtrVector& nodes, const std::string& filePa
     _os = nullptr;
 }
 
+void AstDumper::dumpNode(const AstNodeBase& node, std::ostream& os) {
+    _os = &os;
+    _depth = 0;
+    dump(node);
+    _os = nullptr;
+}
+
 void AstDumper::visit(const AstCompUnit& node) {
     begin("CompUnit");
     dump(*node.next());
@@ -58,7 +65,7 @@ void AstDumper::visit(const AstVarDef& node) {
         }
         end();
     }
-    dump(*node.initVal());
+    if (node.initVal()) dump(*node.initVal());
     end();
 }
 
@@ -109,6 +116,14 @@ void AstDumper::visit(const AstFuncFParam& node) {
     begin("FuncFParam");
     dump(*node.type());
     output("ID: %s", node.id().c_str());
+    if (node.isArray()) {
+        begin("ArrLens");
+        output("(omitted)");
+        for (auto& exp : node.arrLens()) {
+            dump(*exp);
+        }
+        end();
+    }
     end();
 }
 
@@ -244,7 +259,7 @@ void AstDumper::visit(const AstBinaryExp& node) {
             output("/");
             break;
         case BinaryOp::MOD:
-            output("%");
+            output("%%");
             break;
         case BinaryOp::LESS:
             output("<");
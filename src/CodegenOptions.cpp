@@ -0,0 +1,85 @@
+#include "CodegenOptions.hpp"
+#include <llvm/ADT/StringMap.h>
+#include <llvm/ADT/StringSwitch.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Support/Host.h>
+#include <algorithm>
+#include <vector>
+
+std::string CodegenOptions::targetTriple() const {
+    return triple.empty() ? llvm::sys::getDefaultTargetTriple() : triple;
+}
+
+bool CodegenOptions::isHostTarget() const {
+    return llvm::Triple(targetTriple()).getArch() == llvm::Triple(llvm::sys::getDefaultTargetTriple()).getArch();
+}
+
+void CodegenOptions::setTriple(const std::string& name, bool keepCPU) {
+    triple = llvm::Triple::normalize(name);
+    if (!keepCPU) cpu = defaultCPU(triple);
+}
+
+std::string CodegenOptions::defaultCPU(const std::string& triple) {
+    switch (llvm::Triple(triple).getArch()) {
+        case llvm::Triple::arm:
+        case llvm::Triple::thumb:
+        case llvm::Triple::aarch64:
+            // Raspberry Pi 4, in 32 or 64 bit mode
+            return "cortex-a72";
+        case llvm::Triple::riscv64:
+            // the RV64GC cores of the SiFive Unmatched and the VisionFive boards
+            return "sifive-u74";
+        default:
+            return "generic";
+    }
+}
+
+void CodegenOptions::setCPU(const std::string& name) {
+    if (name != "native") {
+        cpu = name;
+        return;
+    }
+    cpu = llvm::sys::getHostCPUName().str();
+    llvm::StringMap<bool> hostFeatures;
+    if (!llvm::sys::getHostCPUFeatures(hostFeatures)) return;
+    // sorted, so the same host always produces the same feature string
+    std::vector<std::string> attrs;
+    for (auto& feature : hostFeatures) {
+        attrs.push_back((feature.second ? "+" : "-") + feature.first().str());
+    }
+    std::sort(attrs.begin(), attrs.end());
+    for (auto& attr : attrs) addFeatures(attr);
+}
+
+void CodegenOptions::addFeatures(const std::string& attrs) {
+    if (attrs.empty()) return;
+    if (!features.empty()) features += ",";
+    features += attrs;
+}
+
+bool CodegenOptions::setRelocModel(const std::string& name) {
+    auto model = llvm::StringSwitch<llvm::Optional<llvm::Reloc::Model>>(name)
+                     .Case("static", llvm::Reloc::Static)
+                     .Case("pic", llvm::Reloc::PIC_)
+                     .Case("dynamic-no-pic", llvm::Reloc::DynamicNoPIC)
+                     .Case("ropi", llvm::Reloc::ROPI)
+                     .Case("rwpi", llvm::Reloc::RWPI)
+                     .Case("ropi-rwpi", llvm::Reloc::ROPI_RWPI)
+                     .Default(llvm::None);
+    if (!model) return false;
+    relocModel = model;
+    return true;
+}
+
+bool CodegenOptions::setCodeModel(const std::string& name) {
+    auto model = llvm::StringSwitch<llvm::Optional<llvm::CodeModel::Model>>(name)
+                     .Case("tiny", llvm::CodeModel::Tiny)
+                     .Case("small", llvm::CodeModel::Small)
+                     .Case("kernel", llvm::CodeModel::Kernel)
+                     .Case("medium", llvm::CodeModel::Medium)
+                     .Case("large", llvm::CodeModel::Large)
+                     .Default(llvm::None);
+    if (!model) return false;
+    codeModel = model;
+    return true;
+}
@@ -0,0 +1,582 @@
+#include "Driver.hpp"
+#include <atomic>
+#include <fstream>
+#include <sstream>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Config/llvm-config.h>
+#include <llvm/Support/CachePruning.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/ThreadPool.h>
+#include "AstDumper.hpp"
+#include "FastBackend.hpp"
+#include "IrGenerator.hpp"
+#include "Lexer.hpp"
+#include "Logger.hpp"
+#include "Parser.hpp"
+
+/**
+ * @brief Link an object file with the SysY runtime into an executable, using the system C compiler driver.
+ */
+static int linkExecutable(const std::string& objPath, const std::string& runtimePath, const std::string& outPath,
+                          bool pie) {
+    auto cc = llvm::sys::findProgramByName("cc");
+    if (!cc) {
+        err() << "cannot find the system linker driver 'cc'\n";
+        return 1;
+    }
+    // code generated with a non-PIC relocation model can only be linked into a position dependent executable
+    llvm::StringRef args[] = {*cc, pie ? "-pie" : "-no-pie", objPath, runtimePath, "-o", outPath};
+    std::string errMsg;
+    int ret = llvm::sys::ExecuteAndWait(*cc, args, llvm::None, {}, 0, 0, &errMsg);
+    if (ret != 0) {
+        err() << "linking failed" << (errMsg.empty() ? "" : ": " + errMsg) << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Everything apart from the source and the output type that decides the generated code.
+ */
+static std::string cacheSettings(const DriverOptions& options) {
+    auto& codegen = options.codegenOptions;
+    std::string profile = options.profileGenerate;
+    if (!options.profileUse.empty()) {
+        // the code depends on the counts, not on where the profile is
+        llvm::SHA1 hash;
+        if (auto buffer = llvm::MemoryBuffer::getFile(options.profileUse)) hash.update((*buffer)->getBuffer());
+        profile += "|" + llvm::toHex(hash.final());
+    }
+    return profile + "|" + std::to_string(options.wholeProgram) + "|" + SYSY_COMPILER_VERSION + "|" + LLVM_VERSION_STRING + "|" + codegen.targetTriple() +
+           "|" + codegen.cpu + "|" + codegen.features + "|" +
+           std::to_string(codegen.relocModel ? *codegen.relocModel + 1 : 0) + "|" +
+           std::to_string(codegen.codeModel ? *codegen.codeModel + 1 : 0) + "|" +
+           std::to_string(codegen.debugInfo) + std::to_string(codegen.framePointer) + "|" +
+           (options.fastBackend ? "fast|" : "llvm|") +
+           std::to_string(options.optLevel.getSpeedupLevel()) + "|" + std::to_string(options.optLevel.getSizeLevel());
+}
+
+/**
+ * @brief Generate IR, assembly or an executable function by function, see IrGenerator::outputIncremental().
+ */
+static int compileIncremental(const DriverOptions& options, IrGenerator& irGen, const std::string& outFilePath) {
+    auto target = options.target;
+    auto settings = cacheSettings(options);
+    if (target == IR) {
+        return irGen.outputIncremental(outFilePath, llvm::None, options.optLevel, options.cacheDir, settings) ? 0 : 1;
+    }
+    if (target == ASM) {
+        return irGen.outputIncremental(outFilePath, llvm::CGFT_AssemblyFile, options.optLevel, options.cacheDir,
+                                       settings)
+                   ? 0
+                   : 1;
+    }
+    llvm::SmallString<128> objPath(outFilePath);
+    llvm::Optional<llvm::FileRemover> objRemover;
+    if (target == EXE) {
+        if (auto ec = llvm::sys::fs::createTemporaryFile("sysy", "o", objPath)) {
+            err() << "cannot create temporary file: " << ec.message() << "\n";
+            return 1;
+        }
+        objRemover.emplace(objPath);
+    }
+    if (!irGen.outputIncremental(std::string(objPath), llvm::CGFT_ObjectFile, options.optLevel, options.cacheDir,
+                                 settings)) {
+        return 1;
+    }
+    if (target == OBJ) return 0;
+    bool pie = options.codegenOptions.relocModel == llvm::Reloc::PIC_;
+    return linkExecutable(std::string(objPath), options.runtimePath, outFilePath, pie);
+}
+
+/**
+ * @brief Generate assembly, an object or an executable with the fast backend, see FastBackend.
+ */
+static int compileFast(const DriverOptions& options, const AstNodePtrVector& compUnits,
+                       const std::string& outFilePath) {
+    auto target = options.target;
+    FastBackend backend(compUnits);
+    if (target == ASM) return backend.output(outFilePath) ? 0 : 1;
+
+    llvm::SmallString<128> asmPath;
+    if (auto ec = llvm::sys::fs::createTemporaryFile("sysy", "s", asmPath)) {
+        err() << "cannot create temporary file: " << ec.message() << "\n";
+        return 1;
+    }
+    llvm::FileRemover asmRemover(asmPath);
+    if (!backend.output(std::string(asmPath))) return 1;
+    // the system compiler driver assembles the output, and links it like an object
+    if (target == EXE) return linkExecutable(std::string(asmPath), options.runtimePath, outFilePath, false);
+    auto cc = llvm::sys::findProgramByName("cc");
+    if (!cc) {
+        err() << "cannot find the system assembler driver 'cc'\n";
+        return 1;
+    }
+    llvm::StringRef args[] = {*cc, "-c", asmPath, "-o", outFilePath};
+    std::string errMsg;
+    if (llvm::sys::ExecuteAndWait(*cc, args, llvm::None, {}, 0, 0, &errMsg) != 0) {
+        err() << "assembling failed" << (errMsg.empty() ? "" : ": " + errMsg) << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Compile without looking at the compile cache.
+ */
+static int compileUncached(const DriverOptions& options, const std::string& inFilePath,
+                           const std::string& outFilePath) {
+    auto target = options.target;
+    std::unique_ptr<IrGenerator> irGen;
+    if (isIrFile(inFilePath)) {
+        if (target == TOKENS || target == AST) {
+            err() << "tokens and AST can only be dumped from SysY source\n";
+            return 1;
+        }
+        // IR generated earlier only goes through the optimizer and the backend
+        irGen = std::make_unique<IrGenerator>(inFilePath, options.codegenOptions);
+        irGen->reportRemarks(options.remarksPassed, options.remarksMissed, options.remarksAnalysis);
+    } else {
+        Lexer lexer(inFilePath);
+        lexer.lex();
+        if (lexer.hasError()) return 1;
+        if (target == TOKENS) {
+            lexer.outputTokens(outFilePath);
+            return 0;
+        }
+        Parser parser(std::move(lexer.getTokens()));
+        parser.parse();
+        if (parser.hasError()) return 1;
+        if (target == AST) {
+            AstDumper dumper;
+            dumper.dumpAll(parser.getCompUnits(), outFilePath);
+            return 0;
+        }
+        if (options.fastBackend) return compileFast(options, parser.getCompUnits(), outFilePath);
+        irGen = std::make_unique<IrGenerator>(std::move(parser.getCompUnits()), options.codegenOptions,
+                                              options.sourceName.empty() ? inFilePath : options.sourceName);
+        irGen->reportRemarks(options.remarksPassed, options.remarksMissed, options.remarksAnalysis);
+        irGen->codegen();
+        if (!options.profileGenerate.empty()) irGen->instrumentProfile(options.profileGenerate);
+        if (!options.profileUse.empty() && !irGen->applyProfile(options.profileUse)) return 1;
+        // after the instrumentation, whose counters are memory accesses as well
+        if (options.wholeProgram) {
+            irGen->annotateWholeProgram();
+            irGen->optimizeGlobals();
+        }
+        if (options.incremental && !options.cacheDir.empty() && target != RUN && target != BC) {
+            return compileIncremental(options, *irGen, outFilePath);
+        }
+    }
+
+    irGen->optimize(options.optLevel);
+    if (target == IR) {
+        irGen->printModule(outFilePath);
+        return 0;
+    }
+    if (target == BC) {
+        return irGen->writeBitcode(outFilePath) ? 0 : 1;
+    }
+    if (target == RUN) {
+        return irGen->run();
+    }
+    if (target == ASM) {
+        return irGen->output(outFilePath, llvm::CGFT_AssemblyFile, options.jobs) ? 0 : 1;
+    }
+    if (target == OBJ) {
+        return irGen->output(outFilePath, llvm::CGFT_ObjectFile, options.jobs) ? 0 : 1;
+    }
+
+    // EXE: emit a temporary object in-process and link it once
+    llvm::SmallString<128> objPath;
+    if (auto ec = llvm::sys::fs::createTemporaryFile("sysy", "o", objPath)) {
+        err() << "cannot create temporary file: " << ec.message() << "\n";
+        return 1;
+    }
+    llvm::FileRemover objRemover(objPath);
+    if (!irGen->output(std::string(objPath), llvm::CGFT_ObjectFile, options.jobs)) return 1;
+    bool pie = options.codegenOptions.relocModel == llvm::Reloc::PIC_;
+    return linkExecutable(std::string(objPath), options.runtimePath, outFilePath, pie);
+}
+
+/**
+ * @brief Hash the source and everything else that decides the output of a target.
+ *
+ * SysY source is normalized so trailing spaces and tabs don't matter, but line numbers stay the same. Other
+ * whitespace, like the carriage return of CRLF line endings, is an error for the lexer and stays in the key.
+ */
+static std::string cacheKey(const DriverOptions& options, Target target, const std::string& inFilePath,
+                            llvm::StringRef source, bool normalize) {
+    llvm::SHA1 hash;
+    // the number of jobs doesn't change partitioned output, only whether the module is partitioned does
+    hash.update(cacheSettings(options) + "|" + std::to_string(target) + "|" + std::to_string(options.jobs > 0) + "|" +
+                std::to_string(options.incremental));
+    // the output names the source file (source_filename, .file, debug info)
+    hash.update(options.sourceName.empty() ? inFilePath : options.sourceName);
+    hash.update(llvm::StringRef("\0", 1));
+    if (!normalize) {
+        hash.update(source);
+        return llvm::toHex(hash.final());
+    }
+
+    llvm::SmallVector<llvm::StringRef, 64> lines;
+    source.split(lines, '\n');
+    while (!lines.empty() && lines.back().trim(" \t").empty()) lines.pop_back();
+    for (auto line : lines) {
+        hash.update(line.rtrim(" \t"));
+        hash.update("\n");
+    }
+    return llvm::toHex(hash.final());
+}
+
+static int compileCached(const DriverOptions& options, const std::string& inFilePath,
+                         const std::string& outFilePath) {
+    // an executable is linked from the cached object
+    auto stage = options.target == EXE ? OBJ : options.target;
+    auto source = llvm::MemoryBuffer::getFile(inFilePath);
+    if (!source) return compileUncached(options, inFilePath, outFilePath);
+
+    if (auto ec = llvm::sys::fs::create_directories(options.cacheDir)) {
+        err() << "cannot create cache directory " << options.cacheDir << ": " << ec.message() << "\n";
+        return 1;
+    }
+    // only files named llvmcache-* are considered by pruneCache()
+    llvm::SmallString<128> entryPath(options.cacheDir);
+    llvm::sys::path::append(entryPath, "llvmcache-" + cacheKey(options, stage, inFilePath, (*source)->getBuffer(),
+                                                               !isIrFile(inFilePath)));
+
+    auto finish = [&](const llvm::Twine& path) {
+        if (options.target == EXE) {
+            bool pie = options.codegenOptions.relocModel == llvm::Reloc::PIC_;
+            return linkExecutable(path.str(), options.runtimePath, outFilePath, pie);
+        }
+        return llvm::sys::fs::copy_file(path, outFilePath) ? 1 : 0;
+    };
+
+    int fd;
+    if (!llvm::sys::fs::openFileForRead(entryPath, fd)) {
+        // mark the entry as recently used for the LRU eviction
+        llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+        llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+        log() << "(Driver) " << inFilePath << " found in the compile cache.\n";
+        // the entry may have been evicted in the meantime by another compiler
+        if (finish(entryPath) == 0) return 0;
+    }
+
+    // write next to the entry and rename, so others never see a partial entry
+    llvm::SmallString<128> tmpPath(options.cacheDir);
+    llvm::sys::path::append(tmpPath, "tmp-%%%%%%%%%%%%");
+    if (auto ec = llvm::sys::fs::createUniqueFile(tmpPath, tmpPath)) {
+        err() << "cannot create cache entry: " << ec.message() << "\n";
+        return 1;
+    }
+    llvm::FileRemover tmpRemover(tmpPath);
+    auto stageOptions = options;
+    stageOptions.target = stage;
+    if (int ret = compileUncached(stageOptions, inFilePath, std::string(tmpPath))) return ret;
+    if (int ret = finish(tmpPath)) return ret;
+    if (auto ec = llvm::sys::fs::rename(tmpPath, entryPath)) {
+        err() << "cannot store cache entry: " << ec.message() << "\n";
+    }
+    return 0;
+}
+
+int compileFile(const DriverOptions& options, const std::string& inFilePath, const std::string& outFilePath) {
+    auto target = options.target;
+    if (options.cacheDir.empty() || target == TOKENS || target == AST || target == RUN) {
+        return compileUncached(options, inFilePath, outFilePath);
+    }
+    if (!options.remarksPassed.empty() || !options.remarksMissed.empty() || !options.remarksAnalysis.empty()) {
+        // remarks come from the optimizer, which cached code does not go through again
+        auto uncachedOptions = options;
+        uncachedOptions.cacheDir.clear();
+        return compileUncached(uncachedOptions, inFilePath, outFilePath);
+    }
+    return compileCached(options, inFilePath, outFilePath);
+}
+
+void pruneCompileCache(const DriverOptions& options) {
+    if (options.cacheDir.empty()) return;
+    llvm::CachePruningPolicy policy;
+    // prune on every run, so the cap holds whenever the compiler is not running
+    policy.Interval = std::chrono::seconds(0);
+    policy.MaxSizeBytes = options.cacheSizeLimit;
+    llvm::pruneCache(options.cacheDir, policy);
+}
+
+int compileBatch(const DriverOptions& options, const std::vector<std::pair<std::string, std::string>>& files,
+                 unsigned threads) {
+    std::atomic<unsigned> failed(0);
+    std::mutex errMutex;
+    {
+        // idle workers take the next file from the shared queue, so long files don't hold up the rest
+        llvm::ThreadPool pool(llvm::hardware_concurrency(threads));
+        for (auto& file : files) {
+            pool.async([&] {
+                std::ostringstream messages;
+                logger().redirect(&messages);
+                int ret;
+                try {
+                    ret = compileFile(options, file.first, file.second);
+                } catch (std::exception& e) {
+                    err() << e.what() << "\n";
+                    ret = 1;
+                }
+                logger().redirect(nullptr);
+                if (ret != 0) {
+                    failed++;
+                    std::lock_guard<std::mutex> lock(errMutex);
+                    err() << "failed to compile " << file.first << "\n" << messages.str();
+                }
+            });
+        }
+        pool.wait();
+    }
+    log() << "(Driver) " << files.size() - failed << " of " << files.size() << " files compiled.\n";
+    return failed ? 1 : 0;
+}
+
+std::string batchOutputPath(const std::string& inFilePath, Target target, const std::string& outDir) {
+    static const char* extensions[] = {".tokens", ".ast", ".ll", ".bc", ".s", ".o", "", ""};
+    llvm::SmallString<128> path(inFilePath);
+    llvm::sys::path::replace_extension(path, extensions[target]);
+    if (outDir.empty()) return std::string(path);
+    llvm::SmallString<128> outPath(outDir);
+    llvm::sys::path::append(outPath, llvm::sys::path::filename(path));
+    return std::string(outPath);
+}
+
+bool readBatchManifest(const std::string& path, Target target, const std::string& outDir,
+                       std::vector<std::pair<std::string, std::string>>& files) {
+    std::ifstream manifest(path);
+    if (!manifest) {
+        err() << "cannot open batch manifest " << path << "\n";
+        return false;
+    }
+    std::string line;
+    while (std::getline(manifest, line)) {
+        std::istringstream fields(line);
+        std::string inFilePath, outFilePath;
+        if (!(fields >> inFilePath) || inFilePath[0] == '#') continue;
+        if (!(fields >> outFilePath)) outFilePath = batchOutputPath(inFilePath, target, outDir);
+        files.emplace_back(inFilePath, outFilePath);
+    }
+    return true;
+}
+
+bool isIrFile(const std::string& path) {
+    auto extension = llvm::sys::path::extension(path);
+    return extension == ".ll" || extension == ".bc";
+}
+
+bool parseCommandLine(const std::vector<std::string>& args, CommandLine& cmd) {
+    auto& options = cmd.options;
+    auto& codegenOptions = options.codegenOptions;
+    auto startsWith = [](const std::string& arg, const char* prefix) { return arg.rfind(prefix, 0) == 0; };
+    // an explicit CPU wins over the default of the target, whatever the order
+    bool cpuGiven = false;
+
+    for (size_t i = 0; i < args.size(); i++) {
+        auto& arg = args[i];
+        if (arg == "-l") {
+            options.target = TOKENS;
+        } else if (arg == "-p") {
+            options.target = AST;
+        } else if (arg == "-i") {
+            options.target = IR;
+        } else if (arg == "-emit-bc") {
+            options.target = BC;
+        } else if (arg == "-s") {
+            options.target = ASM;
+        } else if (arg == "-c") {
+            options.target = OBJ;
+        } else if (arg == "-run") {
+            options.target = RUN;
+        } else if (startsWith(arg, "--runtime=")) {
+            options.runtimePath = arg.substr(10);
+        } else if (startsWith(arg, "--cache-dir=")) {
+            options.cacheDir = arg.substr(12);
+        } else if (startsWith(arg, "--cache-size=")) {
+            // same syntax as the cache_size_bytes of LLVM's cache pruning policies, e.g. 512m
+            auto policy = llvm::parseCachePruningPolicy("cache_size_bytes=" + arg.substr(13));
+            if (!policy) {
+                err() << llvm::toString(policy.takeError()) << "\n";
+                return false;
+            }
+            options.cacheSizeLimit = policy->MaxSizeBytes;
+        } else if (arg == "-fprofile-generate") {
+            options.profileGenerate = "default.sysyprof";
+        } else if (startsWith(arg, "-fprofile-generate=")) {
+            options.profileGenerate = arg.substr(19);
+        } else if (startsWith(arg, "-fprofile-use=")) {
+            options.profileUse = arg.substr(14);
+        } else if (startsWith(arg, "-Rpass=") || startsWith(arg, "-Rpass-missed=") ||
+                   startsWith(arg, "-Rpass-analysis=")) {
+            auto pattern = arg.substr(arg.find('=') + 1);
+            std::string error;
+            if (!llvm::Regex(pattern).isValid(error)) {
+                err() << "invalid regular expression in " << arg << ": " << error << "\n";
+                return false;
+            }
+            (startsWith(arg, "-Rpass=") ? options.remarksPassed
+             : startsWith(arg, "-Rpass-missed=") ? options.remarksMissed
+                                                 : options.remarksAnalysis) = pattern;
+        } else if (arg == "-g") {
+            codegenOptions.debugInfo = true;
+        } else if (arg == "-fno-omit-frame-pointer") {
+            codegenOptions.framePointer = true;
+        } else if (arg == "-fomit-frame-pointer") {
+            codegenOptions.framePointer = false;
+        } else if (startsWith(arg, "-backend=")) {
+            auto backend = arg.substr(9);
+            if (backend != "fast" && backend != "llvm") {
+                err() << "unknown backend: " << backend << "\n";
+                return false;
+            }
+            options.fastBackend = backend == "fast";
+        } else if (arg == "-fno-whole-program") {
+            options.wholeProgram = false;
+        } else if (arg == "--incremental") {
+            options.incremental = true;
+        } else if (startsWith(arg, "--batch=")) {
+            cmd.manifestPath = arg.substr(8);
+        } else if (arg == "--server" || arg == "--client") {
+            if (i + 1 >= args.size()) {
+                err() << "missing socket path after '" << arg << "'\n";
+                return false;
+            }
+            (arg == "--server" ? cmd.serverSocket : cmd.clientSocket) = args[++i];
+        } else if (arg == "-O0") {
+            options.optLevel = llvm::OptimizationLevel::O0;
+        } else if (arg == "-O1") {
+            options.optLevel = llvm::OptimizationLevel::O1;
+        } else if (arg == "-O2") {
+            options.optLevel = llvm::OptimizationLevel::O2;
+        } else if (arg == "-O3") {
+            options.optLevel = llvm::OptimizationLevel::O3;
+        } else if (startsWith(arg, "--target=")) {
+            codegenOptions.setTriple(arg.substr(9), cpuGiven);
+        } else if (startsWith(arg, "-march=")) {
+            codegenOptions.setCPU(arg.substr(7));
+            cpuGiven = true;
+        } else if (startsWith(arg, "-mcpu=")) {
+            codegenOptions.setCPU(arg.substr(6));
+            cpuGiven = true;
+        } else if (startsWith(arg, "-mattr=")) {
+            codegenOptions.addFeatures(arg.substr(7));
+        } else if (startsWith(arg, "-mcmodel=")) {
+            if (!codegenOptions.setCodeModel(arg.substr(9))) {
+                err() << "unknown code model: " << arg.substr(9) << "\n";
+                return false;
+            }
+        } else if (startsWith(arg, "-relocation-model=")) {
+            if (!codegenOptions.setRelocModel(arg.substr(18))) {
+                err() << "unknown relocation model: " << arg.substr(18) << "\n";
+                return false;
+            }
+        } else if (startsWith(arg, "-j")) {
+            // "-j N" or "-jN"
+            std::string num = arg.size() > 2 ? arg.substr(2) : (i + 1 < args.size() ? args[++i] : "");
+            if (llvm::StringRef(num).getAsInteger(10, cmd.jobs) || cmd.jobs == 0) {
+                err() << "invalid number of jobs: " << num << "\n";
+                return false;
+            }
+        } else if (arg == "-o") {
+            if (i + 1 >= args.size()) {
+                err() << "missing output file after '-o'\n";
+                return false;
+            }
+            cmd.outFilePath = args[++i];
+        } else if (arg[0] == '-') {
+            err() << "unknown option: " << arg << "\n";
+            return false;
+        } else {
+            cmd.inFilePaths.push_back(arg);
+        }
+    }
+
+    if (options.incremental && options.cacheDir.empty()) {
+        err() << "--incremental needs a --cache-dir\n";
+        return false;
+    }
+    if (!codegenOptions.isHostTarget() && (options.target == EXE || options.target == RUN)) {
+        err() << "code for " << codegenOptions.triple << " cannot be linked or run here, use -s or -c\n";
+        return false;
+    }
+    if (options.fastBackend) {
+        // the fast backend skips LLVM altogether
+        if (options.target == IR || options.target == BC || options.target == RUN) {
+            err() << "-backend=fast generates assembly, objects and executables only\n";
+            return false;
+        }
+        if (llvm::Triple(codegenOptions.targetTriple()).getArch() != llvm::Triple::x86_64) {
+            err() << "-backend=fast only generates code for x86-64\n";
+            return false;
+        }
+        if (options.optLevel != llvm::OptimizationLevel::O0 || codegenOptions.debugInfo ||
+            !options.profileGenerate.empty() || !options.profileUse.empty() || options.incremental) {
+            err() << "-backend=fast does not optimize, nor support -g, profiles or --incremental\n";
+            return false;
+        }
+        for (auto& inFilePath : cmd.inFilePaths) {
+            if (isIrFile(inFilePath)) {
+                err() << "-backend=fast only compiles SysY source: " << inFilePath << "\n";
+                return false;
+            }
+        }
+    }
+    if (!cmd.serverSocket.empty()) return true;
+    if (cmd.isBatch()) {
+        if (options.target == RUN) {
+            err() << "-run takes a single input file\n";
+            return false;
+        }
+        return true;
+    }
+    if (cmd.inFilePaths.empty() || (cmd.outFilePath.empty() && options.target != RUN)) {
+        err() << "invalid arguments\n";
+        return false;
+    }
+    return true;
+}
+
+int runCommandLine(const CommandLine& cmd) {
+    // batch mode: -j is the number of files compiled at once and -o an output directory
+    if (cmd.isBatch()) {
+        std::vector<std::pair<std::string, std::string>> files;
+        if (!cmd.manifestPath.empty() &&
+            !readBatchManifest(cmd.manifestPath, cmd.options.target, cmd.outFilePath, files)) {
+            return 1;
+        }
+        for (auto& inFilePath : cmd.inFilePaths) {
+            files.emplace_back(inFilePath, batchOutputPath(inFilePath, cmd.options.target, cmd.outFilePath));
+        }
+        if (!cmd.outFilePath.empty()) {
+            if (auto ec = llvm::sys::fs::create_directories(cmd.outFilePath)) {
+                err() << "cannot create output directory " << cmd.outFilePath << ": " << ec.message() << "\n";
+                return 1;
+            }
+        }
+        int ret = compileBatch(cmd.options, files, cmd.jobs);
+        pruneCompileCache(cmd.options);
+        return ret;
+    }
+
+    auto options = cmd.options;
+    options.jobs = cmd.jobs;
+    int ret;
+    try {
+        ret = compileFile(options, cmd.inFilePaths[0], cmd.outFilePath);
+    } catch (std::exception& e) {
+        err() << e.what() << "\n";
+        ret = 1;
+    }
+    pruneCompileCache(options);
+    return ret;
+}
@@ -0,0 +1,591 @@
+#include "FastBackend.hpp"
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <numeric>
+#include <stdexcept>
+#include "Logger.hpp"
+#include "Runtime.hpp"
+
+// registers of the first integer arguments in the SysV ABI
+static const char* const ArgRegs[] = {"%rdi", "%rsi", "%rdx", "%rcx", "%r8", "%r9"};
+static const size_t ArgRegCount = 6;
+
+FastBackend::FastBackend(const AstNodePtrVector& compUnits) : _compUnits(compUnits) {
+    for (auto& runtime : runtimeFunctions()) {
+        // starttime() and stoptime() are called without arguments, see visit(AstFuncCall)
+        _functions[runtime.name] = {runtime.passesLine ? 0 : runtime.params.size(), runtime.symbol, true};
+    }
+}
+
+bool FastBackend::output(const std::string& path) {
+    log() << "(FastBackend) Start code generation...\n";
+    _scopes.assign(1, {});
+    _text << "\t.text\n";
+    for (auto& compUnit : _compUnits) {
+        generate(*compUnit);
+    }
+
+    std::ofstream of(path, std::ios::out);
+    if (!of) {
+        err() << "(FastBackend) cannot open the output file " << path << "\n";
+        return false;
+    }
+    of << _text.str() << "\t.data\n" << _data.str() << "\t.bss\n" << _bss.str();
+    // the stack is not executable
+    of << "\t.section .note.GNU-stack,\"\",@progbits\n";
+    log() << "(FastBackend) Code generation done.\n";
+    return static_cast<bool>(of);
+}
+
+void FastBackend::push() {
+    emit("pushq %rax");
+    _depth += 8;
+}
+
+void FastBackend::pop(const std::string& reg) {
+    emit("popq " + reg);
+    _depth -= 8;
+}
+
+int FastBackend::allocate(int size, int align) {
+    _frameSize = (_frameSize + size + align - 1) / align * align;
+    return -_frameSize;
+}
+
+const FastBackend::Symbol& FastBackend::lookupSymbol(const std::string& name) const {
+    for (auto scope = _scopes.rbegin(); scope != _scopes.rend(); ++scope) {
+        auto it = scope->find(name);
+        if (it != scope->end()) return it->second;
+    }
+    throw std::runtime_error("unknown variable name");
+}
+
+bool FastBackend::evalConst(const AstNodeBase& node, int& value) const {
+    if (auto exp = dynamic_cast<const AstExp*>(&node)) return evalConst(*exp->addExp(), value);
+    if (auto cond = dynamic_cast<const AstCond*>(&node)) return evalConst(*cond->lOrExp(), value);
+    if (auto primary = dynamic_cast<const AstPrimaryExp*>(&node)) return evalConst(*primary->exp(), value);
+    if (auto number = dynamic_cast<const AstNumber*>(&node)) {
+        value = number->val();
+        return true;
+    }
+    if (auto unary = dynamic_cast<const AstUnaryExp*>(&node)) {
+        if (!evalConst(*unary->exp(), value)) return false;
+        // the same two's complement wrap-around as the generated code
+        if (unary->op() == UnaryOp::MINUS) value = static_cast<int>(0u - static_cast<unsigned>(value));
+        if (unary->op() == UnaryOp::NOT) value = !value;
+        return true;
+    }
+    auto binary = dynamic_cast<const AstBinaryExp*>(&node);
+    if (!binary) return false;
+    int lhs, rhs;
+    if (!evalConst(*binary->lhs(), lhs)) return false;
+    if (binary->op() == BinaryOp::SINGLE) {
+        value = lhs;
+        return true;
+    }
+    if (!evalConst(*binary->rhs(), rhs)) return false;
+    auto l = static_cast<unsigned>(lhs), r = static_cast<unsigned>(rhs);
+    switch (binary->op()) {
+        case BinaryOp::PLUS: value = static_cast<int>(l + r); return true;
+        case BinaryOp::SUB: value = static_cast<int>(l - r); return true;
+        case BinaryOp::MUL: value = static_cast<int>(l * r); return true;
+        case BinaryOp::DIV:
+        case BinaryOp::MOD:
+            if (rhs == 0 || (lhs == INT32_MIN && rhs == -1)) return false;
+            value = binary->op() == BinaryOp::DIV ? lhs / rhs : lhs % rhs;
+            return true;
+        case BinaryOp::LESS: value = lhs < rhs; return true;
+        case BinaryOp::GREATER: value = lhs > rhs; return true;
+        case BinaryOp::LESSEQ: value = lhs <= rhs; return true;
+        case BinaryOp::GREATEREQ: value = lhs >= rhs; return true;
+        case BinaryOp::EQUAL: value = lhs == rhs; return true;
+        case BinaryOp::NEQUAL: value = lhs != rhs; return true;
+        case BinaryOp::LOGICAND: value = lhs && rhs; return true;
+        case BinaryOp::LOGICOR: value = lhs || rhs; return true;
+        default: return false;
+    }
+}
+
+std::vector<int> FastBackend::evalArrayLens(const std::vector<AstExpPtr>& arrLens) const {
+    std::vector<int> dims;
+    for (auto& exp : arrLens) {
+        int len;
+        if (!evalConst(*exp, len) || len < 0) throw std::runtime_error("array length must be a non-negative constant");
+        dims.push_back(len);
+    }
+    return dims;
+}
+
+void FastBackend::flattenInitVal(const AstInitVal& initVal, const std::vector<int>& dims, size_t depth,
+                                 size_t begin, std::vector<const AstNodeBase*>& elems) const {
+    // number of elements in a sub-array starting at dimension d
+    auto size = [&](size_t d) {
+        return std::accumulate(dims.begin() + d, dims.end(), size_t(1), std::multiplies<>());
+    };
+    size_t end = begin + size(depth);
+    size_t pos = begin;
+    for (auto& child : initVal.initVals()) {
+        if (pos >= end) throw std::runtime_error("excess elements in array initializer");
+        if (child->exp()) {
+            elems[pos++] = child->exp().get();
+            continue;
+        }
+        size_t d = depth + 1;
+        while (d < dims.size() && (pos - begin) % size(d) != 0) d++;
+        if (d >= dims.size()) throw std::runtime_error("braces around scalar initializer");
+        flattenInitVal(*child, dims, d, pos, elems);
+        pos += size(d);
+    }
+}
+
+void FastBackend::defineGlobal(const AstVarDef& def) {
+    auto dims = evalArrayLens(def.arrLens());
+    auto count = std::accumulate(dims.begin(), dims.end(), size_t(1), std::multiplies<>());
+    std::vector<int> values(count, 0);
+    if (def.initVal() != nullptr) {
+        std::vector<const AstNodeBase*> exps(count, nullptr);
+        if (dims.empty()) {
+            if (!def.initVal()->exp()) throw std::runtime_error("braces around scalar initializer");
+            exps[0] = def.initVal()->exp().get();
+        } else {
+            if (def.initVal()->exp()) throw std::runtime_error("array initializer must be a braced list");
+            flattenInitVal(*def.initVal(), dims, 0, 0, exps);
+        }
+        for (size_t i = 0; i < count; i++) {
+            if (exps[i] && !evalConst(*exps[i], values[i])) {
+                throw std::runtime_error("initializer element of " + def.id() + " is not constant");
+            }
+        }
+    }
+
+    auto align = count > 1 ? 16 : 4;
+    if (std::all_of(values.begin(), values.end(), [](int value) { return value == 0; })) {
+        _bss << "\t.p2align " << (align == 16 ? 4 : 2) << "\n" << def.id() << ":\n\t.zero " << count * 4 << "\n";
+    } else {
+        _data << "\t.p2align " << (align == 16 ? 4 : 2) << "\n" << def.id() << ":\n";
+        for (size_t i = 0; i < count;) {
+            // runs of zeros take one directive
+            size_t zeros = 0;
+            while (i + zeros < count && values[i + zeros] == 0) zeros++;
+            if (zeros > 1) {
+                _data << "\t.zero " << zeros * 4 << "\n";
+                i += zeros;
+            } else {
+                _data << "\t.long " << values[i++] << "\n";
+            }
+        }
+    }
+    _scopes.front()[def.id()] = {def.id(), 0, dims, false};
+}
+
+void FastBackend::lvalAddress(const AstLVal& node, const Symbol& symbol) {
+    auto& dims = symbol.dims;
+    if (node.indices().size() > dims.size()) throw std::runtime_error("too many indices for array " + node.id());
+    // the offset is summed up on the stack, then the base is added
+    for (size_t i = 0; i < node.indices().size(); i++) {
+        auto stride = std::accumulate(dims.begin() + i + 1, dims.end(), 4L, std::multiplies<>());
+        generate(*node.indices()[i]);
+        emit("movslq %eax, %rax");
+        emit("imulq $" + std::to_string(stride) + ", %rax");
+        if (i > 0) {
+            pop("%rcx");
+            emit("addq %rcx, %rax");
+        }
+        push();
+    }
+    if (!node.indices().empty()) pop("%rcx");
+    if (!symbol.global.empty()) {
+        emit("leaq " + symbol.global + "(%rip), %rax");
+    } else if (symbol.pointer) {
+        emit("movq " + std::to_string(symbol.offset) + "(%rbp), %rax");
+    } else {
+        emit("leaq " + std::to_string(symbol.offset) + "(%rbp), %rax");
+    }
+    if (!node.indices().empty()) emit("addq %rcx, %rax");
+}
+
+std::string FastBackend::compare(const AstBinaryExp& node) {
+    std::string cc;
+    switch (node.op()) {
+        case BinaryOp::LESS: cc = "l"; break;
+        case BinaryOp::GREATER: cc = "g"; break;
+        case BinaryOp::LESSEQ: cc = "le"; break;
+        case BinaryOp::GREATEREQ: cc = "ge"; break;
+        case BinaryOp::EQUAL: cc = "e"; break;
+        case BinaryOp::NEQUAL: cc = "ne"; break;
+        default: return cc;
+    }
+    generate(*node.lhs());
+    push();
+    generate(*node.rhs());
+    emit("movl %eax, %ecx");
+    pop("%rax");
+    emit("cmpl %ecx, %eax");
+    return cc;
+}
+
+void FastBackend::condjump(const AstNodeBase& node, const std::string& trueLabel, const std::string& falseLabel) {
+    // look through the nodes wrapping a single expression
+    if (auto cond = dynamic_cast<const AstCond*>(&node)) return condjump(*cond->lOrExp(), trueLabel, falseLabel);
+    if (auto exp = dynamic_cast<const AstExp*>(&node)) return condjump(*exp->addExp(), trueLabel, falseLabel);
+    if (auto primary = dynamic_cast<const AstPrimaryExp*>(&node)) return condjump(*primary->exp(), trueLabel, falseLabel);
+    if (auto unary = dynamic_cast<const AstUnaryExp*>(&node)) {
+        if (unary->op() == UnaryOp::SINGLE) return condjump(*unary->exp(), trueLabel, falseLabel);
+        if (unary->op() == UnaryOp::NOT) return condjump(*unary->exp(), falseLabel, trueLabel);
+    }
+    if (auto binary = dynamic_cast<const AstBinaryExp*>(&node)) {
+        if (binary->op() == BinaryOp::SINGLE) return condjump(*binary->lhs(), trueLabel, falseLabel);
+        if (binary->op() == BinaryOp::LOGICAND || binary->op() == BinaryOp::LOGICOR) {
+            auto rhsLabel = newLabel();
+            if (binary->op() == BinaryOp::LOGICAND) {
+                // lhs false skips rhs
+                condjump(*binary->lhs(), rhsLabel, falseLabel);
+            } else {
+                // lhs true skips rhs
+                condjump(*binary->lhs(), trueLabel, rhsLabel);
+            }
+            label(rhsLabel);
+            return condjump(*binary->rhs(), trueLabel, falseLabel);
+        }
+        auto cc = compare(*binary);
+        if (!cc.empty()) {
+            emit("j" + cc + " " + trueLabel);
+            emit("jmp " + falseLabel);
+            return;
+        }
+    }
+
+    // arithmetic value: true when not zero
+    generate(node);
+    emit("testl %eax, %eax");
+    emit("jne " + trueLabel);
+    emit("jmp " + falseLabel);
+}
+
+void FastBackend::visit(const AstCompUnit& node) {
+    generate(*node.next());
+}
+
+void FastBackend::visit(const AstDecl& node) {
+    if (!node.decl()) throw std::runtime_error("const declarations are not supported");
+    generate(*node.decl());
+}
+
+void FastBackend::visit(const AstBType& node) {}
+
+void FastBackend::visit(const AstVarDecl& node) {
+    if (_scopes.size() == 1) {
+        // top level declaration
+        for (auto& def : node.varDefs()) {
+            defineGlobal(*def);
+        }
+        return;
+    }
+    for (auto& def : node.varDefs()) {
+        if (!def->arrLens().empty()) {
+            auto dims = evalArrayLens(def->arrLens());
+            auto count = std::accumulate(dims.begin(), dims.end(), size_t(1), std::multiplies<>());
+            auto offset = allocate(count * 4, 16);
+            _scopes.back()[def->id()] = {"", offset, dims, false};
+            if (def->initVal() == nullptr) continue;
+            if (def->initVal()->exp()) throw std::runtime_error("array initializer must be a braced list");
+            std::vector<const AstNodeBase*> exps(count, nullptr);
+            flattenInitVal(*def->initVal(), dims, 0, 0, exps);
+            // zero everything, then store the given elements
+            emit("leaq " + std::to_string(offset) + "(%rbp), %rdi");
+            emit("movl $" + std::to_string(count) + ", %ecx");
+            emit("xorl %eax, %eax");
+            emit("rep stosl");
+            for (size_t i = 0; i < count; i++) {
+                if (!exps[i]) continue;
+                generate(*exps[i]);
+                emit("movl %eax, " + std::to_string(offset + i * 4) + "(%rbp)");
+            }
+            continue;
+        }
+        // uninitialized scalars are zero, like in the LLVM backend
+        if (def->initVal() != nullptr) {
+            if (!def->initVal()->exp()) throw std::runtime_error("braces around scalar initializer");
+            generate(*def->initVal()->exp());
+        } else {
+            emit("xorl %eax, %eax");
+        }
+        // the initializer still sees an outer variable of the same name
+        auto offset = allocate(4, 4);
+        emit("movl %eax, " + std::to_string(offset) + "(%rbp)");
+        _scopes.back()[def->id()] = {"", offset, {}, false};
+    }
+}
+
+void FastBackend::visit(const AstVarDef& node) {}
+
+void FastBackend::visit(const AstInitVal& node) {}
+
+void FastBackend::visit(const AstFuncDef& node) {
+    size_t paramCount = node.params() ? node.params()->params().size() : 0;
+    _functions[node.id()] = {paramCount, node.id(), false};
+    _scopes.emplace_back();
+    _frameSize = 0;
+    _depth = 0;
+    _retLabel = newLabel();
+
+    // the prologue is written once the size of the frame is known
+    std::ostringstream body;
+    std::swap(body, _text);
+    for (size_t i = 0; i < paramCount; i++) {
+        auto& param = *node.params()->params()[i];
+        Symbol symbol;
+        if (param.isArray()) {
+            symbol.dims = evalArrayLens(param.arrLens());
+            symbol.dims.insert(symbol.dims.begin(), 0);
+            symbol.pointer = true;
+        }
+        if (i < ArgRegCount) {
+            symbol.offset = allocate(8, 8);
+            emit("movq " + std::string(ArgRegs[i]) + ", " + std::to_string(symbol.offset) + "(%rbp)");
+        } else {
+            // passed on the stack, above the return address
+            symbol.offset = 16 + 8 * (i - ArgRegCount);
+        }
+        _scopes.back()[param.id()] = symbol;
+    }
+    generate(*node.block());
+    // falling off the end of an int function returns 0
+    if (node.funcType()->type() == FuncType::INT) emit("xorl %eax, %eax");
+    label(_retLabel);
+    emit("leave");
+    emit("ret");
+    std::swap(body, _text);
+
+    if (node.id() == "main") _text << "\t.globl main\n";
+    _text << "\t.type " << node.id() << ", @function\n" << node.id() << ":\n";
+    emit("pushq %rbp");
+    emit("movq %rsp, %rbp");
+    auto frameSize = (_frameSize + 15) / 16 * 16;
+    if (frameSize > 0) emit("subq $" + std::to_string(frameSize) + ", %rsp");
+    _text << body.str() << "\t.size " << node.id() << ", .-" << node.id() << "\n";
+    _scopes.pop_back();
+}
+
+void FastBackend::visit(const AstFuncType& node) {}
+
+void FastBackend::visit(const AstFuncFParams& node) {}
+
+void FastBackend::visit(const AstFuncFParam& node) {}
+
+void FastBackend::visit(const AstBlock& node) {
+    for (auto& item : node.items()) {
+        generate(*item);
+        // items after 'return', 'break' or 'continue' are dead code
+        auto& stmt = *static_cast<const AstBlockItem&>(*item).declOrStmt();
+        if (dynamic_cast<const AstReturnStmt*>(&stmt) || dynamic_cast<const AstBreakStmt*>(&stmt) ||
+            dynamic_cast<const AstContinueStmt*>(&stmt)) {
+            break;
+        }
+    }
+}
+
+void FastBackend::visit(const AstBlockItem& node) {
+    generate(*node.declOrStmt());
+}
+
+void FastBackend::visit(const AstAssignStmt& node) {
+    generate(*node.exp());
+    auto& symbol = lookupSymbol(node.lVal()->id());
+    if (symbol.dims.empty()) {
+        if (!node.lVal()->indices().empty()) throw std::runtime_error("subscripted value is not an array");
+        if (!symbol.global.empty()) {
+            emit("movl %eax, " + symbol.global + "(%rip)");
+        } else {
+            emit("movl %eax, " + std::to_string(symbol.offset) + "(%rbp)");
+        }
+        return;
+    }
+    if (node.lVal()->indices().size() < symbol.dims.size()) throw std::runtime_error("array type is not assignable");
+    push();
+    lvalAddress(*node.lVal(), symbol);
+    pop("%rcx");
+    emit("movl %ecx, (%rax)");
+}
+
+void FastBackend::visit(const AstExpStmt& node) {
+    if (node.exp()) generate(*node.exp());
+}
+
+void FastBackend::visit(const AstBlockStmt& node) {
+    _scopes.emplace_back();
+    generate(*node.block());
+    _scopes.pop_back();
+}
+
+void FastBackend::visit(const AstIfStmt& node) {
+    auto thenLabel = newLabel(), elseLabel = newLabel(), endLabel = newLabel();
+    condjump(*node.cond(), thenLabel, node.elseStmt() ? elseLabel : endLabel);
+    label(thenLabel);
+    generate(*node.stmt());
+    if (node.elseStmt()) {
+        emit("jmp " + endLabel);
+        label(elseLabel);
+        generate(*node.elseStmt());
+    }
+    label(endLabel);
+}
+
+void FastBackend::visit(const AstWhileStmt& node) {
+    auto condLabel = newLabel(), bodyLabel = newLabel(), endLabel = newLabel();
+    label(condLabel);
+    condjump(*node.cond(), bodyLabel, endLabel);
+    label(bodyLabel);
+    _loops.push_back({condLabel, endLabel});
+    generate(*node.stmt());
+    _loops.pop_back();
+    emit("jmp " + condLabel);
+    label(endLabel);
+}
+
+void FastBackend::visit(const AstBreakStmt& node) {
+    if (_loops.empty()) throw std::runtime_error("'break' statement not in loop statement");
+    emit("jmp " + _loops.back().breakLabel);
+}
+
+void FastBackend::visit(const AstContinueStmt& node) {
+    if (_loops.empty()) throw std::runtime_error("'continue' statement not in loop statement");
+    emit("jmp " + _loops.back().continueLabel);
+}
+
+void FastBackend::visit(const AstReturnStmt& node) {
+    if (node.exp()) generate(*node.exp());
+    emit("jmp " + _retLabel);
+}
+
+void FastBackend::visit(const AstExp& node) {
+    generate(*node.addExp());
+}
+
+void FastBackend::visit(const AstCond& node) {
+    generate(*node.lOrExp());
+}
+
+void FastBackend::visit(const AstLVal& node) {
+    auto& symbol = lookupSymbol(node.id());
+    if (symbol.dims.empty()) {
+        if (!node.indices().empty()) throw std::runtime_error("subscripted value is not an array");
+        if (!symbol.global.empty()) {
+            emit("movl " + symbol.global + "(%rip), %eax");
+        } else {
+            emit("movl " + std::to_string(symbol.offset) + "(%rbp), %eax");
+        }
+        return;
+    }
+    lvalAddress(node, symbol);
+    // a sub-array used as a value (i.e. passed to a function) is its address
+    if (node.indices().size() == symbol.dims.size()) emit("movl (%rax), %eax");
+}
+
+void FastBackend::visit(const AstPrimaryExp& node) {
+    generate(*node.exp());
+}
+
+void FastBackend::visit(const AstNumber& node) {
+    emit("movl $" + std::to_string(node.val()) + ", %eax");
+}
+
+void FastBackend::visit(const AstBinaryExp& node) {
+    if (node.op() == BinaryOp::SINGLE) return generate(*node.lhs());
+    if (node.op() == BinaryOp::LOGICAND || node.op() == BinaryOp::LOGICOR) {
+        // a logical expression used as a value: branch on it and set 1 / 0
+        auto trueLabel = newLabel(), falseLabel = newLabel(), endLabel = newLabel();
+        condjump(node, trueLabel, falseLabel);
+        label(trueLabel);
+        emit("movl $1, %eax");
+        emit("jmp " + endLabel);
+        label(falseLabel);
+        emit("xorl %eax, %eax");
+        label(endLabel);
+        return;
+    }
+    auto cc = compare(node);
+    if (!cc.empty()) {
+        emit("set" + cc + " %al");
+        emit("movzbl %al, %eax");
+        return;
+    }
+
+    generate(*node.lhs());
+    push();
+    generate(*node.rhs());
+    emit("movl %eax, %ecx");
+    pop("%rax");
+    switch (node.op()) {
+        case BinaryOp::PLUS:
+            emit("addl %ecx, %eax");
+            break;
+        case BinaryOp::SUB:
+            emit("subl %ecx, %eax");
+            break;
+        case BinaryOp::MUL:
+            emit("imull %ecx, %eax");
+            break;
+        case BinaryOp::DIV:
+        case BinaryOp::MOD:
+            emit("cltd");
+            emit("idivl %ecx");
+            if (node.op() == BinaryOp::MOD) emit("movl %edx, %eax");
+            break;
+        default:
+            throw std::runtime_error("unexpected binary operator");
+    }
+}
+
+void FastBackend::visit(const AstUnaryExp& node) {
+    generate(*node.exp());
+    switch (node.op()) {
+        case UnaryOp::MINUS:
+            emit("negl %eax");
+            break;
+        case UnaryOp::NOT:
+            // logical not: 1 if exp == 0, otherwise 0
+            emit("testl %eax, %eax");
+            emit("sete %al");
+            emit("movzbl %al, %eax");
+            break;
+        default:
+            break;
+    }
+}
+
+void FastBackend::visit(const AstFuncRParams& node) {}
+
+void FastBackend::visit(const AstFuncCall& node) {
+    auto it = _functions.find(node.id());
+    if (it == _functions.end()) throw std::runtime_error("Unknown function reference");
+    auto& func = it->second;
+    auto& args = node.params();
+    if (args.size() != func.paramCount) throw std::runtime_error("Incorrent arguments passed");
+
+    // Arguments are evaluated into an area on the stack: the ones passed on the stack at the bottom, in order,
+    // the ones passed in registers above. %rsp must be 16 byte aligned at the call.
+    size_t stackArgs = args.size() > ArgRegCount ? args.size() - ArgRegCount : 0;
+    int area = args.size() * 8;
+    area += (16 - (_depth + area) % 16) % 16;
+    if (area > 0) emit("subq $" + std::to_string(area) + ", %rsp");
+    _depth += area;
+    for (size_t i = 0; i < args.size(); i++) {
+        generate(*args[i]);
+        auto slot = i < ArgRegCount ? stackArgs + i : i - ArgRegCount;
+        emit("movq %rax, " + std::to_string(slot * 8) + "(%rsp)");
+    }
+    for (size_t i = 0; i < args.size() && i < ArgRegCount; i++) {
+        emit("movq " + std::to_string((stackArgs + i) * 8) + "(%rsp), " + ArgRegs[i]);
+    }
+    if (func.external && findRuntimeFunction(node.id())->passesLine) {
+        // starttime() and stoptime() pass the line of the call
+        emit("movl $" + std::to_string(node.lineno()) + ", %edi");
+    }
+    // no vector registers are used by a variadic callee
+    emit("xorl %eax, %eax");
+    emit("call " + func.symbol + (func.external ? "@PLT" : ""));
+    if (area > 0) emit("addq $" + std::to_string(area) + ", %rsp");
+    _depth -= area;
+}
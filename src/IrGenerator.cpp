@@ -1,92 +1,1385 @@
 #include "IrGenerator.hpp"
-#include <llvm/Transforms/Scalar/DCE.h>
-#include <llvm/Transforms/InstCombine/InstCombine.h>
-#include <llvm/Transforms/Scalar.h>
+#include <llvm/Bitcode/BitcodeReader.h>
+#include <llvm/Bitcode/BitcodeWriter.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ADT/SCCIterator.h>
+#include <llvm/ADT/Triple.h>
+#include <llvm/Analysis/AliasAnalysis.h>
+#include <llvm/Analysis/CFG.h>
+#include <llvm/Analysis/CallGraph.h>
+#include <llvm/Analysis/ValueTracking.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/InstIterator.h>
+#include <llvm/IR/IntrinsicInst.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Linker/Linker.h>
+#include <llvm/MC/MCSubtargetInfo.h>
+#include <llvm/Passes/PassBuilder.h>
+#include <llvm/ProfileData/InstrProf.h>
+#include <llvm/ProfileData/ProfileCommon.h>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/MD5.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/Process.h>
+#include <llvm/Support/Regex.h>
+#include <llvm/Support/Program.h>
+#include <llvm/Support/SHA1.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/ThreadPool.h>
 #include <llvm/Transforms/Utils/BasicBlockUtils.h>
+#include <llvm/Transforms/Utils/Cloning.h>
+#include <llvm/Transforms/Utils/Local.h>
+#include <llvm/Transforms/Utils/SplitModule.h>
+#include "AstDumper.hpp"
 #include "Logger.hpp"
+#include <fstream>
+#include <mutex>
+#include <numeric>
+#include <sstream>
 
-IrGenerator::IrGenerator(AstNodePtrVector compUnits)
+extern "C" {
+#include "sylib.h"
+}
+
+IrGenerator::IrGenerator(AstNodePtrVector compUnits, CodegenOptions options, const std::string& sourcePath)
     : _compUnits(std::move(compUnits)),
+      _options(std::move(options)),
       _context(new llvm::LLVMContext),
       _builder(new llvm::IRBuilder<>(*_context)),
       _module(new llvm::Module("SysY", *_context)),
-      _fpm(new llvm::legacy::FunctionPassManager(_module.get())),
       _ret(nullptr) {
-    _fpm->add(llvm::createInstructionCombiningPass());
-    _fpm->add(llvm::createReassociatePass());
-    _fpm->add(llvm::createNewGVNPass());
-    _fpm->add(llvm::createCFGSimplificationPass());
-    _fpm->doInitialization();
+    if (!sourcePath.empty()) _module->setSourceFileName(sourcePath);
+    initTarget();
+
+    for (auto& runtime : runtimeFunctions()) {
+        addExternFunction(runtime);
+    }
+}
 
-    addExternFunction("getint", llvm::Type::getInt32Ty(*_context), std::vector<llvm::Type*>());
-    addExternFunction("putint", llvm::Type::getVoidTy(*_context), std::vector<llvm::Type*>(1, llvm::Type::getInt32Ty(*_context)));
-    addExternFunction("getch", llvm::Type::getInt32Ty(*_context), std::vector<llvm::Type*>());
-    addExternFunction("putch", llvm::Type::getVoidTy(*_context), std::vector<llvm::Type*>(1, llvm::Type::getInt32Ty(*_context)));
+IrGenerator::IrGenerator(const std::string& irFilePath, CodegenOptions options)
+    : _options(std::move(options)),
+      _context(new llvm::LLVMContext),
+      _builder(new llvm::IRBuilder<>(*_context)),
+      _ret(nullptr) {
+    llvm::SMDiagnostic diag;
+    _module = llvm::parseIRFile(irFilePath, diag, *_context);
+    if (!_module) {
+        std::string message;
+        llvm::raw_string_ostream os(message);
+        diag.print(nullptr, os, false);
+        throw std::runtime_error(os.str());
+    }
+    initTarget();
 }
 
-llvm::AllocaInst* IrGenerator::createEntryBlockAlloca(llvm::Function* func, const std::string& varName = "") const {
+llvm::AllocaInst* IrGenerator::createEntryBlockAlloca(llvm::Function* func, llvm::Type* type, const std::string& varName = "") const {
     llvm::IRBuilder<> tmpB(&func->getEntryBlock(),
                            func->getEntryBlock().begin());
-    return tmpB.CreateAlloca(llvm::Type::getInt32Ty(*_context), nullptr, varName);
+    return tmpB.CreateAlloca(type, nullptr, varName);
 }
 
-void IrGenerator::addExternFunction(const char* name, llvm::Type* retType, const std::vector<llvm::Type*>& params) {
-    auto funcType = llvm::FunctionType::get(retType, params, false);
-    llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, name, _module.get());
+void IrGenerator::condgen(const AstNodeBase& node, llvm::BasicBlock* trueBB, llvm::BasicBlock* falseBB) {
+    // look through the nodes wrapping a single expression
+    if (auto cond = dynamic_cast<const AstCond*>(&node)) return condgen(*cond->lOrExp(), trueBB, falseBB);
+    if (auto exp = dynamic_cast<const AstExp*>(&node)) return condgen(*exp->addExp(), trueBB, falseBB);
+    if (auto primary = dynamic_cast<const AstPrimaryExp*>(&node)) return condgen(*primary->exp(), trueBB, falseBB);
+    if (auto unary = dynamic_cast<const AstUnaryExp*>(&node)) {
+        if (unary->op() == UnaryOp::SINGLE) return condgen(*unary->exp(), trueBB, falseBB);
+        if (unary->op() == UnaryOp::NOT) return condgen(*unary->exp(), falseBB, trueBB);
+    }
+
+    auto func = _builder->GetInsertBlock()->getParent();
+    if (auto binary = dynamic_cast<const AstBinaryExp*>(&node)) {
+        switch (binary->op()) {
+            case BinaryOp::SINGLE:
+                return condgen(*binary->lhs(), trueBB, falseBB);
+            case BinaryOp::LOGICAND: {
+                // lhs false skips rhs
+                auto rhsBB = llvm::BasicBlock::Create(*_context, "land.rhs");
+                condgen(*binary->lhs(), rhsBB, falseBB);
+                sealBlock(rhsBB);
+                func->getBasicBlockList().push_back(rhsBB);
+                _builder->SetInsertPoint(rhsBB);
+                return condgen(*binary->rhs(), trueBB, falseBB);
+            }
+            case BinaryOp::LOGICOR: {
+                // lhs true skips rhs
+                auto rhsBB = llvm::BasicBlock::Create(*_context, "lor.rhs");
+                condgen(*binary->lhs(), trueBB, rhsBB);
+                sealBlock(rhsBB);
+                func->getBasicBlockList().push_back(rhsBB);
+                _builder->SetInsertPoint(rhsBB);
+                return condgen(*binary->rhs(), trueBB, falseBB);
+            }
+            case BinaryOp::LESS:
+            case BinaryOp::GREATER:
+            case BinaryOp::LESSEQ:
+            case BinaryOp::GREATEREQ:
+            case BinaryOp::EQUAL:
+            case BinaryOp::NEQUAL: {
+                // branch on the comparison itself, no i1 -> i32 -> i1 round trip
+                auto lhs = codegen(*binary->lhs());
+                auto rhs = codegen(*binary->rhs());
+                _builder->CreateCondBr(createCompare(binary->op(), lhs, rhs), trueBB, falseBB);
+                return;
+            }
+            default:
+                // arithmetic, generated once below
+                break;
+        }
+    }
+
+    // arithmetic value: true when not zero
+    auto val = codegen(node);
+    if (auto constant = llvm::dyn_cast<llvm::ConstantInt>(val)) {
+        _builder->CreateBr(constant->isZero() ? falseBB : trueBB);
+        return;
+    }
+    auto cmp = _builder->CreateICmpNE(val, llvm::ConstantInt::get(val->getType(), 0));
+    _builder->CreateCondBr(cmp, trueBB, falseBB);
+}
+
+llvm::Value* IrGenerator::createCompare(BinaryOp op, llvm::Value* lhs, llvm::Value* rhs) {
+    switch (op) {
+        case BinaryOp::LESS:
+            return _builder->CreateICmpSLT(lhs, rhs);
+        case BinaryOp::GREATER:
+            return _builder->CreateICmpSGT(lhs, rhs);
+        case BinaryOp::LESSEQ:
+            return _builder->CreateICmpSLE(lhs, rhs);
+        case BinaryOp::GREATEREQ:
+            return _builder->CreateICmpSGE(lhs, rhs);
+        case BinaryOp::EQUAL:
+            return _builder->CreateICmpEQ(lhs, rhs);
+        case BinaryOp::NEQUAL:
+            return _builder->CreateICmpNE(lhs, rhs);
+        default:
+            return nullptr;
+    }
+}
+
+llvm::MDNode* IrGenerator::createLoopID(bool mustProgress) {
+    // the first operand of a loop ID refers to itself
+    llvm::SmallVector<llvm::Metadata*, 2> ops{nullptr};
+    if (mustProgress) ops.push_back(llvm::MDNode::get(*_context, llvm::MDString::get(*_context, "llvm.loop.mustprogress")));
+    auto loopID = llvm::MDNode::getDistinct(*_context, ops);
+    loopID->replaceOperandWith(0, loopID);
+    return loopID;
+}
+
+const IrGenerator::Symbol& IrGenerator::lookupSymbol(const std::string& name) const {
+    auto it = _namedValues.find(name);
+    if (it == _namedValues.end()) throw std::runtime_error("unknown variable name");
+    return it->second;
+}
+
+std::vector<uint64_t> IrGenerator::evalArrayLens(const std::vector<AstExpPtr>& arrLens) {
+    std::vector<uint64_t> dims;
+    for (auto& exp : arrLens) {
+        // the builder folds constant expressions, anything else is not a valid length
+        auto len = llvm::dyn_cast<llvm::ConstantInt>(codegen(*exp));
+        if (!len || len->isNegative()) throw std::runtime_error("array length must be a non-negative constant");
+        dims.push_back(len->getZExtValue());
+    }
+    return dims;
+}
+
+llvm::Type* IrGenerator::getArrayType(const std::vector<uint64_t>& dims) const {
+    llvm::Type* type = llvm::Type::getInt32Ty(*_context);
+    for (auto it = dims.rbegin(); it != dims.rend(); ++it) {
+        type = llvm::ArrayType::get(type, *it);
+    }
+    return type;
+}
+
+void IrGenerator::flattenInitVal(const AstInitVal& initVal, const std::vector<uint64_t>& dims, size_t depth,
+                                 size_t begin, std::vector<const AstNodeBase*>& elems) {
+    // number of elements in a sub-array starting at dimension d
+    auto size = [&](size_t d) {
+        return std::accumulate(dims.begin() + d, dims.end(), uint64_t(1), std::multiplies<>());
+    };
+    size_t end = begin + size(depth);
+    size_t pos = begin;
+    for (auto& child : initVal.initVals()) {
+        if (pos >= end) throw std::runtime_error("excess elements in array initializer");
+        if (child->exp()) {
+            elems[pos++] = child->exp().get();
+            continue;
+        }
+        size_t d = depth + 1;
+        while (d < dims.size() && (pos - begin) % size(d) != 0) d++;
+        if (d >= dims.size()) throw std::runtime_error("braces around scalar initializer");
+        flattenInitVal(*child, dims, d, pos, elems);
+        pos += size(d);
+    }
+}
+
+std::vector<llvm::Value*> IrGenerator::codegenArrayInit(const std::vector<uint64_t>& dims, const AstInitVal& initVal) {
+    if (initVal.exp()) throw std::runtime_error("array initializer must be a braced list");
+    auto count = std::accumulate(dims.begin(), dims.end(), uint64_t(1), std::multiplies<>());
+    std::vector<const AstNodeBase*> exps(count, nullptr);
+    flattenInitVal(initVal, dims, 0, 0, exps);
+
+    std::vector<llvm::Value*> elems(count, nullptr);
+    for (uint64_t i = 0; i < count; i++) {
+        if (!exps[i]) continue;
+        auto val = codegen(*exps[i]);
+        // explicit zeros are treated like the implicit ones
+        auto constant = llvm::dyn_cast<llvm::ConstantInt>(val);
+        if (!constant || !constant->isZero()) elems[i] = val;
+    }
+    return elems;
+}
+
+llvm::Constant* IrGenerator::getConstantArray(llvm::Type* type, llvm::ArrayRef<llvm::Value*> elems) const {
+    if (llvm::all_of(elems, [](auto elem) { return elem == nullptr; })) return llvm::Constant::getNullValue(type);
+    if (!type->isArrayTy()) return llvm::cast<llvm::Constant>(elems.front());
+
+    auto arrayType = llvm::cast<llvm::ArrayType>(type);
+    auto elemType = arrayType->getElementType();
+    if (elemType->isIntegerTy()) {
+        std::vector<uint32_t> data;
+        for (auto elem : elems) {
+            data.push_back(elem ? llvm::cast<llvm::ConstantInt>(elem)->getZExtValue() : 0);
+        }
+        return llvm::ConstantDataArray::get(*_context, data);
+    }
+    std::vector<llvm::Constant*> rows;
+    auto rowSize = elems.size() / arrayType->getNumElements();
+    for (uint64_t i = 0; i < arrayType->getNumElements(); i++) {
+        rows.push_back(getConstantArray(elemType, elems.slice(i * rowSize, rowSize)));
+    }
+    return llvm::ConstantArray::get(arrayType, rows);
+}
+
+// Initializers with more non-zero constant elements than this are copied from a constant global
+static const size_t MaxInitStores = 16;
+
+void IrGenerator::initLocalArray(llvm::AllocaInst* array, const std::vector<uint64_t>& dims, const AstInitVal& initVal) {
+    auto elems = codegenArrayInit(dims, initVal);
+    auto& layout = _module->getDataLayout();
+    auto type = array->getAllocatedType();
+    auto size = layout.getTypeAllocSize(type);
+    auto align = array->getAlign();
+
+    auto allConstant = llvm::all_of(elems, [](auto elem) { return elem == nullptr || llvm::isa<llvm::Constant>(elem); });
+    size_t nonZeros = llvm::count_if(elems, [](auto elem) { return elem != nullptr; });
+    if (allConstant && nonZeros > MaxInitStores) {
+        // copy the whole array from a private constant, like clang does for large constant initializers
+        auto func = _builder->GetInsertBlock()->getParent();
+        auto init = new llvm::GlobalVariable(*_module, type, true, llvm::GlobalValue::PrivateLinkage,
+                                             getConstantArray(type, elems),
+                                             "__const." + func->getName() + "." + array->getName());
+        init->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+        init->setAlignment(align);
+        _builder->CreateMemCpy(array, align, init, align, size);
+        return;
+    }
+
+    // zero everything at once, then store only the non-zero elements
+    _builder->CreateMemSet(array, _builder->getInt8(0), size, align);
+    auto indexType = layout.getIndexType(array->getType());
+    std::vector<llvm::Value*> indices(dims.size() + 1);
+    for (uint64_t i = 0; i < elems.size(); i++) {
+        if (!elems[i]) continue;
+        // row-major flat index -> one index per dimension
+        auto rest = i;
+        indices[0] = llvm::ConstantInt::get(indexType, 0);
+        for (size_t d = dims.size(); d > 0; d--) {
+            indices[d] = llvm::ConstantInt::get(indexType, rest % dims[d - 1]);
+            rest /= dims[d - 1];
+        }
+        _builder->CreateStore(elems[i], _builder->CreateInBoundsGEP(type, array, indices));
+    }
+}
+
+// A run of trailing zeros longer than this is emitted as zeroinitializer instead of data
+static const size_t MinZeroTail = 64;
+
+void IrGenerator::defineGlobal(const AstVarDef& def) {
+    auto dims = evalArrayLens(def.arrLens());
+    auto type = getArrayType(dims);
+
+    std::vector<llvm::Value*> elems(std::accumulate(dims.begin(), dims.end(), uint64_t(1), std::multiplies<>()), nullptr);
+    if (def.initVal() != nullptr) {
+        if (dims.empty()) {
+            auto val = codegen(*def.initVal()->exp());
+            auto constant = llvm::dyn_cast<llvm::ConstantInt>(val);
+            if (!constant || !constant->isZero()) elems[0] = val;
+        } else {
+            elems = codegenArrayInit(dims, *def.initVal());
+        }
+    }
+    for (auto elem : elems) {
+        if (elem && !llvm::isa<llvm::Constant>(elem)) throw std::runtime_error("initializer element of " + def.id() + " is not constant");
+    }
+
+    // An array holding a few leading values followed by many zeros is laid out as
+    // <{ [k x i32] data, [n-k x i32] zeroinitializer }>, which keeps the initializer small.
+    llvm::Constant* init;
+    auto lastNonZero = std::find_if(elems.rbegin(), elems.rend(), [](auto elem) { return elem != nullptr; });
+    size_t zeroTail = lastNonZero - elems.rbegin();
+    if (!dims.empty() && lastNonZero != elems.rend() && zeroTail > MinZeroTail) {
+        auto head = llvm::ArrayRef<llvm::Value*>(elems).drop_back(zeroTail);
+        auto headType = llvm::ArrayType::get(llvm::Type::getInt32Ty(*_context), head.size());
+        auto tailType = llvm::ArrayType::get(llvm::Type::getInt32Ty(*_context), zeroTail);
+        init = llvm::ConstantStruct::getAnon({getConstantArray(headType, head), llvm::Constant::getNullValue(tailType)}, true);
+    } else {
+        init = getConstantArray(type, elems);
+    }
+
+    auto global = new llvm::GlobalVariable(*_module, init->getType(), false, llvm::GlobalValue::ExternalLinkage, init, def.id());
+    global->setDSOLocal(true);
+    global->setAlignment(llvm::Align(_module->getDataLayout().getPrefTypeAlignment(type)));
+    if (_diBuilder) {
+        global->addDebugInfo(_diBuilder->createGlobalVariableExpression(
+            _diCompileUnit, def.id(), "", _diCompileUnit->getFile(), def.lineno(), getDebugType(type), false));
+    }
+    // the rest of codegen always sees the declared array type
+    auto addr = llvm::ConstantExpr::getBitCast(global, type->getPointerTo());
+    _namedValues[def.id()] = {0, addr, type, false};
+}
+
+llvm::Value* IrGenerator::lvalAddress(const AstLVal& node, llvm::Type*& type) {
+    auto& symbol = lookupSymbol(node.id());
+    if (!symbol.addr) throw std::runtime_error("subscripted value is not an array");
+    type = symbol.type;
+    if (node.indices().empty()) return symbol.addr;
+
+    // Indices are sign extended to the pointer width once here, like C's integer promotion,
+    // which keeps the address arithmetic in a form loop strength reduction understands.
+    auto indexType = _module->getDataLayout().getIndexType(symbol.addr->getType());
+    std::vector<llvm::Value*> indices;
+    // arrays are addressed through a pointer to the whole array, parameters through the first element
+    if (!symbol.decayed) indices.push_back(llvm::ConstantInt::get(indexType, 0));
+    for (auto& index : node.indices()) {
+        indices.push_back(_builder->CreateSExt(codegen(*index), indexType, "idxprom"));
+    }
+    type = llvm::GetElementPtrInst::getIndexedType(symbol.type, indices);
+    if (!type) throw std::runtime_error("too many indices for array " + node.id());
+    return _builder->CreateInBoundsGEP(symbol.type, symbol.addr, indices, "arrayidx");
+}
+
+void IrGenerator::createDebugCompileUnit() {
+    llvm::SmallString<128> path(_module->getSourceFileName());
+    llvm::sys::fs::make_absolute(path);
+    _diBuilder = std::make_unique<llvm::DIBuilder>(*_module);
+    auto file = _diBuilder->createFile(llvm::sys::path::filename(path), llvm::sys::path::parent_path(path));
+    // without -g the locations are only tracked for remarks, no debug info is emitted
+    _diCompileUnit = _diBuilder->createCompileUnit(
+        llvm::dwarf::DW_LANG_C99, file, "SysY compiler " SYSY_COMPILER_VERSION, false, "", 0, "",
+        _options.debugInfo ? llvm::DICompileUnit::FullDebug : llvm::DICompileUnit::NoDebug);
+    _module->addModuleFlag(llvm::Module::Warning, "Dwarf Version", 4);
+    _module->addModuleFlag(llvm::Module::Warning, "Debug Info Version", llvm::DEBUG_METADATA_VERSION);
+}
+
+llvm::DIType* IrGenerator::getDebugType(llvm::Type* type) {
+    auto arrayType = llvm::dyn_cast<llvm::ArrayType>(type);
+    if (!arrayType) return _diBuilder->createBasicType("int", 32, llvm::dwarf::DW_ATE_signed);
+    // int a[2][3] is an array of 2 arrays of 3 ints
+    auto& layout = _module->getDataLayout();
+    llvm::Metadata* subscripts[] = {_diBuilder->getOrCreateSubrange(0, arrayType->getNumElements())};
+    return _diBuilder->createArrayType(layout.getTypeSizeInBits(type), layout.getABITypeAlignment(type) * 8,
+                                       getDebugType(arrayType->getElementType()),
+                                       _diBuilder->getOrCreateArray(subscripts));
+}
+
+llvm::DILocalVariable* IrGenerator::createDebugVariable(const std::string& name, llvm::DIType* type, unsigned argNo) {
+    if (!_diSubprogram) return nullptr;
+    auto line = _builder->getCurrentDebugLocation().getLine();
+    if (argNo > 0) {
+        return _diBuilder->createParameterVariable(_diSubprogram, name, argNo, _diSubprogram->getFile(), line, type);
+    }
+    return _diBuilder->createAutoVariable(_diSubprogram, name, _diSubprogram->getFile(), line, type);
+}
+
+void IrGenerator::emitDebugValue(llvm::DILocalVariable* var, llvm::Value* value) {
+    if (!var) return;
+    _diBuilder->insertDbgValueIntrinsic(value, var, _diBuilder->createExpression(),
+                                        _builder->getCurrentDebugLocation().get(), _builder->GetInsertBlock());
+}
+
+unsigned IrGenerator::newVariable(const std::string& name, llvm::Type* type) {
+    _variables.push_back({name, type});
+    return _variables.size() - 1;
+}
+
+void IrGenerator::writeVariable(unsigned var, llvm::BasicBlock* block, llvm::Value* value) {
+    _currentDef[block][var] = value;
+}
+
+llvm::Value* IrGenerator::readVariable(unsigned var, llvm::BasicBlock* block) {
+    auto& defs = _currentDef[block];
+    auto it = defs.find(var);
+    if (it != defs.end()) return it->second;
+    return readVariableRecursive(var, block);
+}
+
+llvm::Value* IrGenerator::readVariableRecursive(unsigned var, llvm::BasicBlock* block) {
+    auto& variable = _variables[var];
+    llvm::Value* val;
+    if (_sealedBlocks.count(block) == 0) {
+        // Predecessors are not known yet, leave an operandless phi to be completed by sealBlock()
+        llvm::IRBuilder<> tmpB(block, block->begin());
+        auto phi = tmpB.CreatePHI(variable.type, 0, variable.name);
+        _incompletePhis[block][var] = phi;
+        val = phi;
+    } else if (block->hasNPredecessors(0)) {
+        // entry block or dead code: the variable is never defined on any path
+        val = llvm::UndefValue::get(variable.type);
+    } else if (auto pred = block->getSinglePredecessor()) {
+        // no phi needed with only one predecessor
+        val = readVariable(var, pred);
+    } else {
+        // Break potential cycles with an operandless phi
+        llvm::IRBuilder<> tmpB(block, block->begin());
+        auto phi = tmpB.CreatePHI(variable.type, 0, variable.name);
+        writeVariable(var, block, phi);
+        val = addPhiOperands(var, phi);
+    }
+    writeVariable(var, block, val);
+    return val;
+}
+
+llvm::Value* IrGenerator::addPhiOperands(unsigned var, llvm::PHINode* phi) {
+    for (auto pred : llvm::predecessors(phi->getParent())) {
+        phi->addIncoming(readVariable(var, pred), pred);
+    }
+    return tryRemoveTrivialPhi(phi);
+}
+
+llvm::Value* IrGenerator::tryRemoveTrivialPhi(llvm::PHINode* phi) {
+    llvm::Value* same = nullptr;
+    for (auto& op : phi->incoming_values()) {
+        if (op == same || op == phi) continue;  // unique value or self-reference
+        if (same) return phi;                   // the phi merges at least two values: not trivial
+        same = op;
+    }
+    if (!same) same = llvm::UndefValue::get(phi->getType());  // the phi is unreachable or in the entry block
+
+    // Remember all users except the phi itself, they might become trivial after the replacement.
+    // Handles follow replaceAllUsesWith, so removing a user phi below never leaves them dangling.
+    std::vector<llvm::WeakTrackingVH> users;
+    for (auto user : phi->users()) {
+        if (user != phi && llvm::isa<llvm::PHINode>(user)) users.emplace_back(user);
+    }
+    llvm::WeakTrackingVH result(same);
+    // this also updates every current definition referring to the phi
+    phi->replaceAllUsesWith(same);
+    phi->eraseFromParent();
+
+    for (auto& user : users) {
+        if (auto userPhi = llvm::dyn_cast_or_null<llvm::PHINode>(static_cast<llvm::Value*>(user))) tryRemoveTrivialPhi(userPhi);
+    }
+    return result;
+}
+
+void IrGenerator::sealBlock(llvm::BasicBlock* block) {
+    auto incomplete = std::move(_incompletePhis[block]);
+    _incompletePhis.erase(block);
+    for (auto& [var, phi] : incomplete) {
+        addPhiOperands(var, phi);
+    }
+    _sealedBlocks.insert(block);
+}
+
+void IrGenerator::addExternFunction(const RuntimeFunction& runtime) {
+    auto getType = [&](RuntimeType type) -> llvm::Type* {
+        switch (type) {
+            case RuntimeType::VOID: return llvm::Type::getVoidTy(*_context);
+            case RuntimeType::INT: return llvm::Type::getInt32Ty(*_context);
+            default: return llvm::Type::getInt32PtrTy(*_context);
+        }
+    };
+    std::vector<llvm::Type*> params;
+    for (auto param : runtime.params) params.push_back(getType(param));
+    auto funcType = llvm::FunctionType::get(getType(runtime.retType), params, false);
+    auto func = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, runtime.symbol, _module.get());
+    for (unsigned i = 0; i < params.size(); i++) {
+        if (runtime.params[i] == RuntimeType::INT) continue;
+        // the runtime only accesses the array during the call
+        func->addParamAttr(i, llvm::Attribute::NoCapture);
+        func->addParamAttr(i, runtime.params[i] == RuntimeType::INT_ARRAY_IN ? llvm::Attribute::ReadOnly
+                                                                              : llvm::Attribute::WriteOnly);
+    }
 }
 
 void IrGenerator::codegen() {
     log() << "(IrGen) Start codegen...\n";
+    // remarks are located at source lines as well
+    if (_options.debugInfo || _context->getDiagHandlerPtr()->isAnyRemarkEnabled()) createDebugCompileUnit();
     for (auto& compUnit : _compUnits) {
-        auto value = codegen(*compUnit);
+        codegen(*compUnit);
     }
+    if (_diBuilder) _diBuilder->finalize();
     log() << "(IrGen) Codegen done.\n";
 }
 
-void IrGenerator::output(const std::string& path, llvm::CodeGenFileType fileType) {
-    llvm::InitializeAllTargetInfos();
-    llvm::InitializeAllTargets();
-    llvm::InitializeAllTargetMCs();
-    llvm::InitializeAllAsmPrinters();
+#define SYSY_TARGET(Name)                     \
+    extern "C" void LLVMInitialize##Name##TargetInfo(); \
+    extern "C" void LLVMInitialize##Name##Target();     \
+    extern "C" void LLVMInitialize##Name##TargetMC();   \
+    extern "C" void LLVMInitialize##Name##AsmPrinter();
+#include "SysYTargets.def"
+
+/**
+ * @brief Register the LLVM target generating code for a triple, if it is linked in.
+ *
+ * Only the registered target info of every linked target is needed to find the one for the triple, so the other
+ * targets never set up their code generators.
+ */
+static void initializeTarget(const std::string& triple) {
+    static std::mutex mutex;
+    static std::set<std::string> initializedArchs;
+    std::lock_guard<std::mutex> lock(mutex);
+    auto arch = llvm::Triple(triple).getArchName().str();
+    if (!initializedArchs.insert(arch).second) return;
+
+    if (llvm::Triple(triple).getArch() == llvm::Triple(llvm::sys::getProcessTriple()).getArch()) {
+        llvm::InitializeNativeTarget();
+        llvm::InitializeNativeTargetAsmPrinter();
+        return;
+    }
+    std::string error;
+#define SYSY_TARGET(Name)                                   \
+    LLVMInitialize##Name##TargetInfo();                     \
+    if (llvm::TargetRegistry::lookupTarget(triple, error)) { \
+        LLVMInitialize##Name##Target();                     \
+        LLVMInitialize##Name##TargetMC();                   \
+        LLVMInitialize##Name##AsmPrinter();                 \
+        return;                                             \
+    }
+#include "SysYTargets.def"
+}
 
-    auto targetTriple = llvm::sys::getDefaultTargetTriple();
-    _module->setTargetTriple(targetTriple);
+void IrGenerator::initTarget() {
+    // IR read from a file keeps its triple unless another target is requested
+    if (_module->getTargetTriple().empty() || !_options.triple.empty()) _module->setTargetTriple(_options.targetTriple());
+    initializeTarget(_module->getTargetTriple());
+
+    // A target machine is not thread-safe, but modules compiled one after another on a thread can share one.
+    thread_local std::map<std::string, std::shared_ptr<llvm::TargetMachine>> targetMachines;
+    auto key = _module->getTargetTriple() + "|" + _options.cpu + "|" + _options.features + "|" +
+               std::to_string(_options.relocModel ? *_options.relocModel + 1 : 0) + "|" +
+               std::to_string(_options.codeModel ? *_options.codeModel + 1 : 0);
+    auto& targetMachine = targetMachines[key];
+    if (!targetMachine) targetMachine = createTargetMachine();
+    _targetMachine = targetMachine;
+    _module->setDataLayout(_targetMachine->createDataLayout());
+}
 
-    std::string Error;
-    auto Target = llvm::TargetRegistry::lookupTarget(targetTriple, Error);
+std::unique_ptr<llvm::TargetMachine> IrGenerator::createTargetMachine() const {
+    auto& targetTriple = _module->getTargetTriple();
 
-    if (!Target) {
-        llvm::errs() << Error;
-        return;
+    std::string error;
+    auto target = llvm::TargetRegistry::lookupTarget(targetTriple, error);
+    if (!target) throw std::runtime_error(error);
+
+    llvm::TargetOptions opt;
+    llvm::Triple triple(targetTriple);
+    if (triple.isRISCV()) {
+        // the Linux ABI passes floating point values in FP registers when the D extension is there
+        std::unique_ptr<llvm::MCSubtargetInfo> subtarget(
+            target->createMCSubtargetInfo(targetTriple, _options.cpu, _options.features));
+        bool hardFloat = subtarget->checkFeatures("+d");
+        opt.MCOptions.ABIName = triple.isArch64Bit() ? (hardFloat ? "lp64d" : "lp64") : (hardFloat ? "ilp32d" : "ilp32");
     }
+    return std::unique_ptr<llvm::TargetMachine>(target->createTargetMachine(
+        targetTriple, _options.cpu, _options.features, opt, _options.relocModel, _options.codeModel));
+}
 
-    auto CPU = "generic";
-    auto Features = "";
+std::vector<std::pair<llvm::Function*, std::vector<llvm::BranchInst*>>> IrGenerator::profileSites() const {
+    std::vector<std::pair<llvm::Function*, std::vector<llvm::BranchInst*>>> sites;
+    for (auto& func : *_module) {
+        if (func.isDeclaration()) continue;
+        sites.emplace_back(&func, std::vector<llvm::BranchInst*>());
+        for (auto& bb : func) {
+            auto br = llvm::dyn_cast<llvm::BranchInst>(bb.getTerminator());
+            if (br && br->isConditional()) sites.back().second.push_back(br);
+        }
+    }
+    return sites;
+}
 
-    llvm::TargetOptions opt;
-    auto rm = llvm::Optional<llvm::Reloc::Model>();
-    auto theTargetMachine =
-        Target->createTargetMachine(targetTriple, CPU, Features, opt, rm);
+uint64_t IrGenerator::profileChecksum(
+    const std::vector<std::pair<llvm::Function*, std::vector<llvm::BranchInst*>>>& sites) {
+    llvm::MD5 hash;
+    for (auto& site : sites) {
+        hash.update(site.first->getName());
+        hash.update(std::to_string(site.second.size()) + ";");
+    }
+    llvm::MD5::MD5Result result;
+    hash.final(result);
+    return result.low();
+}
+
+void IrGenerator::instrumentProfile(const std::string& profilePath) {
+    auto sites = profileSites();
+    unsigned numCounters = 0;
+    for (auto& site : sites) numCounters += 1 + 2 * site.second.size();
+    auto mainFunc = _module->getFunction("main");
+    if (!mainFunc || mainFunc->isDeclaration()) return;
+
+    auto int64Ty = llvm::Type::getInt64Ty(*_context);
+    auto countersTy = llvm::ArrayType::get(int64Ty, numCounters);
+    auto counters = new llvm::GlobalVariable(*_module, countersTy, false, llvm::GlobalValue::InternalLinkage,
+                                             llvm::ConstantAggregateZero::get(countersTy), "__sysy_prof_counters");
+    auto increment = [&](llvm::Value* index) {
+        auto addr = _builder->CreateInBoundsGEP(countersTy, counters, {_builder->getInt64(0), index});
+        auto count = _builder->CreateLoad(int64Ty, addr);
+        _builder->CreateStore(_builder->CreateAdd(count, _builder->getInt64(1)), addr);
+    };
+
+    uint64_t index = 0;
+    for (auto& site : sites) {
+        // count after the allocas, so they stay static
+        auto& entry = site.first->getEntryBlock();
+        auto insertPt = entry.getFirstInsertionPt();
+        while (llvm::isa<llvm::AllocaInst>(*insertPt)) insertPt++;
+        _builder->SetInsertPoint(&entry, insertPt);
+        increment(_builder->getInt64(index++));
+        for (auto br : site.second) {
+            _builder->SetInsertPoint(br);
+            increment(_builder->CreateSelect(br->getCondition(), _builder->getInt64(index),
+                                             _builder->getInt64(index + 1)));
+            index += 2;
+        }
+    }
+
+    // void __sysy_prof_register(long long counters[], int n, long long checksum, const char* path)
+    auto registerFunc = _module->getOrInsertFunction(
+        "__sysy_prof_register", _builder->getVoidTy(), int64Ty->getPointerTo(), _builder->getInt32Ty(), int64Ty,
+        _builder->getInt8PtrTy());
+    auto& entry = mainFunc->getEntryBlock();
+    auto insertPt = entry.getFirstInsertionPt();
+    while (llvm::isa<llvm::AllocaInst>(*insertPt)) insertPt++;
+    _builder->SetInsertPoint(&entry, insertPt);
+    _builder->CreateCall(registerFunc,
+                         {_builder->CreateConstInBoundsGEP2_64(countersTy, counters, 0, 0),
+                          _builder->getInt32(numCounters), _builder->getInt64(profileChecksum(sites)),
+                          _builder->CreateGlobalStringPtr(profilePath, "__sysy_prof_path")});
+    _builder->ClearInsertionPoint();
+}
+
+bool IrGenerator::applyProfile(const std::string& profilePath) {
+    std::ifstream profile(profilePath);
+    if (!profile) {
+        err() << "cannot open profile " << profilePath << "\n";
+        return false;
+    }
+    auto sites = profileSites();
+    uint64_t numCounters = 0;
+    for (auto& site : sites) numCounters += 1 + 2 * site.second.size();
+
+    // written by __sysy_prof_register() in the runtime
+    std::string checksumTag, countersTag;
+    uint64_t checksum, size;
+    profile >> checksumTag >> std::hex >> checksum >> std::dec >> countersTag >> size;
+    std::vector<uint64_t> counts(size);
+    for (auto& count : counts) profile >> count;
+    if (!profile || checksumTag != "checksum" || countersTag != "counters") {
+        err() << "malformed profile " << profilePath << "\n";
+        return false;
+    }
+    if (checksum != profileChecksum(sites) || size != numCounters) {
+        log() << "(IrGen) warning: the profile " << profilePath << " is of another program, ignored.\n";
+        return true;
+    }
+
+    llvm::MDBuilder mdBuilder(*_context);
+    llvm::InstrProfSummaryBuilder summary(llvm::ProfileSummaryBuilder::DefaultCutoffs.vec());
+    uint64_t index = 0;
+    for (auto& site : sites) {
+        // the summary takes the first count of a record as entry count
+        auto begin = counts.begin() + index;
+        summary.addRecord(llvm::InstrProfRecord(std::vector<uint64_t>(begin, begin + 1 + 2 * site.second.size())));
+        auto entryCount = counts[index++];
+        site.first->setEntryCount(llvm::Function::ProfileCount(entryCount, llvm::Function::PCT_Real));
+        for (auto br : site.second) {
+            uint64_t taken = counts[index], notTaken = counts[index + 1];
+            index += 2;
+            // branch weights are 32 bits
+            uint64_t scale = std::max(taken, notTaken) / UINT32_MAX + 1;
+            br->setMetadata(llvm::LLVMContext::MD_prof,
+                            mdBuilder.createBranchWeights(taken / scale, notTaken / scale));
+        }
+    }
+    // lets the inliner and the other passes tell hot from cold code
+    _module->setProfileSummary(summary.getSummary()->getMD(*_context), llvm::ProfileSummary::PSK_Instr);
+    return true;
+}
+
+void IrGenerator::annotateWholeProgram() {
+    // memory a function might touch: locals and constants don't count, the runtime reads and writes (I/O)
+    struct Effects {
+        bool reads = false;
+        bool writes = false;
+        bool mayNotReturn = false;
+        std::set<llvm::GlobalVariable*> globals;  // named by the function or a callee
+    };
+    std::map<llvm::Function*, Effects> effects;
+    auto isLocal = [](llvm::Value* ptr) { return llvm::isa<llvm::AllocaInst>(llvm::getUnderlyingObject(ptr)); };
+    auto isConstant = [](llvm::Value* ptr) {
+        auto global = llvm::dyn_cast<llvm::GlobalVariable>(llvm::getUnderlyingObject(ptr));
+        return global && global->isConstant();
+    };
+    auto callee = [](llvm::Instruction& inst) -> llvm::Function* {
+        auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+        if (!call || !call->getCalledFunction() || call->getCalledFunction()->isIntrinsic()) return nullptr;
+        return call->getCalledFunction();
+    };
+
+    for (auto& func : *_module) {
+        if (func.isIntrinsic()) continue;
+        auto& effect = effects[&func];
+        if (func.isDeclaration()) {
+            effect.reads = effect.writes = true;
+            continue;
+        }
+        // a loop might not terminate
+        llvm::SmallVector<std::pair<const llvm::BasicBlock*, const llvm::BasicBlock*>, 4> backedges;
+        llvm::FindFunctionBackedges(func, backedges);
+        effect.mayNotReturn = !backedges.empty();
+        for (auto& inst : llvm::instructions(func)) {
+            for (auto& op : inst.operands()) {
+                if (!op->getType()->isPointerTy()) continue;
+                if (auto global = llvm::dyn_cast<llvm::GlobalVariable>(llvm::getUnderlyingObject(op))) {
+                    effect.globals.insert(global);
+                }
+            }
+            if (auto load = llvm::dyn_cast<llvm::LoadInst>(&inst)) {
+                auto ptr = load->getPointerOperand();
+                if (!isLocal(ptr) && !isConstant(ptr)) effect.reads = true;
+            } else if (auto store = llvm::dyn_cast<llvm::StoreInst>(&inst)) {
+                if (!isLocal(store->getPointerOperand())) effect.writes = true;
+            } else if (auto memIntrinsic = llvm::dyn_cast<llvm::MemIntrinsic>(&inst)) {
+                if (!isLocal(memIntrinsic->getDest())) effect.writes = true;
+                if (auto transfer = llvm::dyn_cast<llvm::MemTransferInst>(&inst)) {
+                    if (!isLocal(transfer->getSource()) && !isConstant(transfer->getSource())) effect.reads = true;
+                }
+            }
+        }
+    }
+
+    // functions in a cycle of the call graph are recursive, and might not return
+    std::set<llvm::Function*> recursive;
+    llvm::CallGraph callGraph(*_module);
+    for (auto scc = llvm::scc_begin(&callGraph); !scc.isAtEnd(); ++scc) {
+        if (!scc.hasCycle()) continue;
+        for (auto node : *scc) {
+            if (node->getFunction()) {
+                recursive.insert(node->getFunction());
+                effects[node->getFunction()].mayNotReturn = true;
+            }
+        }
+    }
 
-    _module->setDataLayout(theTargetMachine->createDataLayout());
+    // a function does everything its callees do
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto& func : *_module) {
+            if (func.isDeclaration()) continue;
+            auto& effect = effects[&func];
+            for (auto& inst : llvm::instructions(func)) {
+                auto calledFunc = callee(inst);
+                if (!calledFunc) continue;
+                auto& calleeEffect = effects[calledFunc];
+                Effects merged{effect.reads || calleeEffect.reads, effect.writes || calleeEffect.writes,
+                               effect.mayNotReturn || calleeEffect.mayNotReturn, effect.globals};
+                changed |= merged.reads != effect.reads || merged.writes != effect.writes ||
+                           merged.mayNotReturn != effect.mayNotReturn;
+                merged.globals.insert(calleeEffect.globals.begin(), calleeEffect.globals.end());
+                changed |= merged.globals.size() != effect.globals.size();
+                effect = std::move(merged);
+            }
+        }
+    }
+
+    // An array parameter is noalias if at every call its argument points into an object that no other argument
+    // points into and that the callee can't name itself. Such a parameter of the caller is an object in turn.
+    for (bool changed = true; changed;) {
+        changed = false;
+        for (auto& func : *_module) {
+            if (func.isDeclaration() || func.getName() == "main" || func.hasAddressTaken()) continue;
+            for (auto& arg : func.args()) {
+                if (!arg.getType()->isPointerTy() || arg.hasNoAliasAttr()) continue;
+                bool noAlias = llvm::all_of(func.users(), [&](llvm::User* user) {
+                    auto call = llvm::cast<llvm::CallBase>(user);
+                    auto object = llvm::getUnderlyingObject(call->getArgOperand(arg.getArgNo()));
+                    if (!llvm::isIdentifiedObject(object)) return false;
+                    auto global = llvm::dyn_cast<llvm::GlobalVariable>(object);
+                    if (global && effects[&func].globals.count(global)) return false;
+                    for (auto& other : call->args()) {
+                        if (other.getOperandNo() == arg.getArgNo() || !other->getType()->isPointerTy()) continue;
+                        if (llvm::getUnderlyingObject(other) == object) return false;
+                    }
+                    return true;
+                });
+                if (noAlias) {
+                    arg.addAttr(llvm::Attribute::NoAlias);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    for (auto& func : *_module) {
+        if (func.isIntrinsic()) continue;
+        auto& effect = effects[&func];
+        // SysY has no exceptions
+        func.addFnAttr(llvm::Attribute::NoUnwind);
+        if (!effect.mayNotReturn) func.addFnAttr(llvm::Attribute::WillReturn);
+        if (func.isDeclaration()) continue;
+        if (!recursive.count(&func)) func.addFnAttr(llvm::Attribute::NoRecurse);
+        if (!effect.reads && !effect.writes) {
+            func.addFnAttr(llvm::Attribute::ReadNone);
+        } else if (!effect.writes) {
+            func.addFnAttr(llvm::Attribute::ReadOnly);
+        }
+        // only main is called from outside the program
+        if (func.getName() != "main") {
+            func.setLinkage(llvm::GlobalValue::InternalLinkage);
+            func.setCallingConv(llvm::CallingConv::Fast);
+        }
+    }
+    for (auto& func : *_module) {
+        for (auto& inst : llvm::instructions(func)) {
+            if (auto calledFunc = callee(inst)) {
+                llvm::cast<llvm::CallInst>(inst).setCallingConv(calledFunc->getCallingConv());
+            }
+        }
+    }
+    for (auto& global : _module->globals()) {
+        if (!global.isDeclaration() && !global.hasLocalLinkage()) global.setLinkage(llvm::GlobalValue::InternalLinkage);
+    }
+}
+
+namespace {
+/**
+ * @brief Print the optimization remarks of the passes matching a regular expression of their kind.
+ */
+class RemarkHandler : public llvm::DiagnosticHandler {
+   public:
+    RemarkHandler(const std::string& passed, const std::string& missed, const std::string& analysis)
+        : _passed(passed), _missed(missed), _analysis(analysis) {}
+
+    bool isPassedOptRemarkEnabled(llvm::StringRef pass) const override { return matches(_passed, pass); }
+    bool isMissedOptRemarkEnabled(llvm::StringRef pass) const override { return matches(_missed, pass); }
+    bool isAnalysisRemarkEnabled(llvm::StringRef pass) const override { return matches(_analysis, pass); }
+    bool isAnyRemarkEnabled() const override { return true; }
+
+    bool handleDiagnostics(const llvm::DiagnosticInfo& info) override {
+        auto remark = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&info);
+        if (!remark) return false;
+        if (!remark->isEnabled()) return true;
+        auto flag = remark->getKind() == llvm::DK_OptimizationRemark         ? "-Rpass"
+                    : remark->getKind() == llvm::DK_OptimizationRemarkMissed ? "-Rpass-missed"
+                                                                               : "-Rpass-analysis";
+        auto& out = log() << "(Remark) ";
+        if (remark->isLocationAvailable()) {
+            auto loc = remark->getLocation();
+            out << loc.getRelativePath().str() << ":" << loc.getLine() << " ";
+        }
+        out << "in " << remark->getFunction().getName().str() << ": " << remark->getMsg() << " [" << flag << "="
+            << remark->getPassName().str() << "]\n";
+        return true;
+    }
+
+   private:
+    static bool matches(const std::string& pattern, llvm::StringRef pass) {
+        return !pattern.empty() && llvm::Regex(pattern).match(pass);
+    }
+
+    std::string _passed, _missed, _analysis;
+};
+}  // namespace
+
+void IrGenerator::reportRemarks(const std::string& passed, const std::string& missed, const std::string& analysis) {
+    if (passed.empty() && missed.empty() && analysis.empty()) return;
+    _context->setDiagnosticHandler(std::make_unique<RemarkHandler>(passed, missed, analysis));
+}
+
+/**
+ * @brief Whether the memory a pointer points into might be written through it.
+ */
+static bool mayBeWritten(llvm::Value* ptr) {
+    for (auto& use : ptr->uses()) {
+        auto user = use.getUser();
+        if (llvm::isa<llvm::LoadInst>(user)) continue;
+        if (llvm::isa<llvm::GEPOperator>(user) || llvm::isa<llvm::BitCastOperator>(user)) {
+            if (mayBeWritten(user)) return true;
+            continue;
+        }
+        // passed to a function that only reads it, e.g. the array of a sum
+        auto call = llvm::dyn_cast<llvm::CallBase>(user);
+        if (call && call->isArgOperand(&use) && call->onlyReadsMemory(call->getArgOperandNo(&use))) continue;
+        return true;
+    }
+    return false;
+}
+
+void IrGenerator::optimizeGlobals() {
+    unsigned constants = 0, localized = 0;
+    for (auto& global : _module->globals()) {
+        if (global.isDeclaration() || global.isConstant() || !global.hasLocalLinkage()) continue;
+        if (!mayBeWritten(&global)) {
+            global.setConstant(true);
+            constants++;
+        }
+    }
+
+    // A global accessed by main() only is live for exactly one call of main(), unless main() recurses.
+    auto main = _module->getFunction("main");
+    if (!main || main->isDeclaration() || !main->doesNotRecurse()) return;
+    std::vector<llvm::GlobalVariable*> mainOnly;
+    for (auto& global : _module->globals()) {
+        if (global.isDeclaration() || global.isConstant() || !global.hasLocalLinkage()) continue;
+        if (!global.getValueType()->isIntegerTy()) continue;
+        bool onlyMain = llvm::all_of(global.uses(), [main](llvm::Use& use) {
+            auto inst = llvm::dyn_cast<llvm::Instruction>(use.getUser());
+            if (!inst || inst->getFunction() != main) return false;
+            auto store = llvm::dyn_cast<llvm::StoreInst>(inst);
+            return llvm::isa<llvm::LoadInst>(inst) || (store && store->getPointerOperand() == use.get());
+        });
+        if (onlyMain) mainOnly.push_back(&global);
+    }
+    for (auto global : mainOnly) {
+        auto local = createEntryBlockAlloca(main, global->getValueType(), global->getName().str());
+        new llvm::StoreInst(global->getInitializer(), local, local->getNextNode());
+        global->replaceAllUsesWith(local);
+        global->eraseFromParent();
+        localized++;
+    }
+    log() << "(IrGen) " << constants << " globals made constant, " << localized << " moved into main.\n";
+}
+
+void IrGenerator::optimize(llvm::OptimizationLevel level) {
+    log() << "(IrGen) Start optimization...\n";
+    optimizeModule(*_module, level);
+    log() << "(IrGen) Optimization done.\n";
+}
+
+void IrGenerator::optimizeModule(llvm::Module& module, llvm::OptimizationLevel level) {
+    llvm::LoopAnalysisManager lam;
+    llvm::FunctionAnalysisManager fam;
+    llvm::CGSCCAnalysisManager cgam;
+    llvm::ModuleAnalysisManager mam;
+
+    // Passing the target machine lets the passes query TargetTransformInfo of the real target, which sizes
+    // the vectors of the loop and SLP vectorizers.
+    llvm::PipelineTuningOptions tuning;
+    tuning.LoopVectorization = level.getSpeedupLevel() >= 2;
+    tuning.SLPVectorization = level.getSpeedupLevel() >= 2;
+    llvm::PassBuilder pb(_targetMachine.get(), tuning);
+    pb.registerModuleAnalyses(mam);
+    pb.registerCGSCCAnalyses(cgam);
+    pb.registerFunctionAnalyses(fam);
+    pb.registerLoopAnalyses(lam);
+    pb.crossRegisterProxies(lam, fam, cgam, mam);
+
+    llvm::ModulePassManager mpm;
+    if (level == llvm::OptimizationLevel::O0) {
+        mpm = pb.buildO0DefaultPipeline(level);
+    } else {
+        mpm = pb.buildPerModuleDefaultPipeline(level);
+    }
+    mpm.run(module, mam);
+}
+
+/**
+ * @brief Make the private labels of one assembly partition unique, e.g. ".LBB0_1" becomes ".L2.BB0_1".
+ *
+ * Every partition numbers its functions, blocks and constants from zero, so the labels collide when the
+ * partitions are concatenated. Labels of the form prefix + digit are never generated by the AsmPrinter.
+ */
+static void appendRenamedAssembly(llvm::StringRef text, llvm::StringRef prefix, unsigned part,
+                                  llvm::raw_ostream& out) {
+    auto isSymbolChar = [](char c) { return llvm::isAlnum(c) || c == '_' || c == '.' || c == '$'; };
+    std::string renamed = (prefix + llvm::Twine(part) + ".").str();
+    bool inString = false;
+    for (size_t i = 0; i < text.size(); i++) {
+        char c = text[i];
+        if (inString) {
+            if (c == '\\' && i + 1 < text.size()) {
+                out << c << text[++i];
+                continue;
+            }
+            if (c == '"') inString = false;
+        } else if (c == '"') {
+            inString = true;
+        } else if (text.substr(i).startswith(prefix) && (i == 0 || !isSymbolChar(text[i - 1]))) {
+            out << renamed;
+            i += prefix.size() - 1;
+            continue;
+        }
+        out << c;
+    }
+}
+
+/**
+ * @brief Combine object files into one relocatable object with the system linker.
+ */
+static bool linkRelocatable(const std::vector<std::string>& objPaths, const std::string& outPath) {
+    auto ld = llvm::sys::findProgramByName("ld");
+    if (!ld) {
+        err() << "cannot find the system linker 'ld' to combine the partitions\n";
+        return false;
+    }
+    std::vector<llvm::StringRef> args = {*ld, "-r", "-o", outPath};
+    args.insert(args.end(), objPaths.begin(), objPaths.end());
+    std::string errMsg;
+    if (llvm::sys::ExecuteAndWait(*ld, args, llvm::None, {}, 0, 0, &errMsg) != 0) {
+        err() << "combining the partitions failed" << (errMsg.empty() ? "" : ": " + errMsg) << "\n";
+        return false;
+    }
+    return true;
+}
+
+// Partitions of the module for parallel code generation. The number is fixed, so the output doesn't depend on
+// the number of threads.
+static const unsigned CodegenPartitions = 8;
+
+std::vector<llvm::SmallVector<char, 0>> IrGenerator::emitPartitions(llvm::CodeGenFileType fileType,
+                                                                   unsigned jobs) {
+    // A context can only be used by one thread, so the partitions travel to their threads as bitcode.
+    std::vector<llvm::SmallVector<char, 0>> bitcodes;
+    llvm::SplitModule(
+        *_module, CodegenPartitions,
+        [&](std::unique_ptr<llvm::Module> part) {
+            bitcodes.emplace_back();
+            llvm::raw_svector_ostream os(bitcodes.back());
+            llvm::WriteBitcodeToFile(*part, os);
+        },
+        // with internal functions kept together, a whole program would end up in one partition
+        false);
+
+    std::vector<llvm::SmallVector<char, 0>> results(bitcodes.size());
+    std::vector<std::string> errors(bitcodes.size());
+    {
+        llvm::ThreadPool pool(llvm::hardware_concurrency(jobs));
+        for (size_t i = 0; i < bitcodes.size(); i++) {
+            pool.async([&, i] {
+                llvm::LLVMContext context;
+                auto part = llvm::parseBitcodeFile(llvm::MemoryBufferRef(llvm::StringRef(bitcodes[i].data(),
+                                                                                         bitcodes[i].size()),
+                                                                         "partition"),
+                                                   context);
+                if (!part) {
+                    errors[i] = llvm::toString(part.takeError());
+                    return;
+                }
+                auto targetMachine = createTargetMachine();
+                llvm::raw_svector_ostream os(results[i]);
+                llvm::legacy::PassManager pass;
+                if (targetMachine->addPassesToEmitFile(pass, os, nullptr, fileType)) {
+                    errors[i] = "TheTargetMachine can't emit a file of this type";
+                    return;
+                }
+                pass.run(**part);
+            });
+        }
+        pool.wait();
+    }
+
+    for (auto& error : errors) {
+        if (!error.empty()) throw std::runtime_error(error);
+    }
+    return results;
+}
+
+bool IrGenerator::writeBitcode(const std::string& path) const {
+    std::error_code ec;
+    llvm::raw_fd_ostream os(path, ec);
+    if (ec) {
+        err() << "cannot write " << path << ": " << ec.message() << "\n";
+        return false;
+    }
+    llvm::WriteBitcodeToFile(*_module, os);
+    return true;
+}
+
+bool IrGenerator::output(const std::string& path, llvm::CodeGenFileType fileType, unsigned jobs) {
+    // concatenated assembly would have several compile units refer to the same debug sections
+    bool hasDebugInfo = _module->debug_compile_units_begin() != _module->debug_compile_units_end();
+    if (jobs > 0 && fileType == llvm::CGFT_AssemblyFile && hasDebugInfo) {
+        log() << "(IrGen) Assembly with debug info is generated in one partition.\n";
+        jobs = 0;
+    }
+    if (jobs > 0 && fileType == llvm::CGFT_ObjectFile && !_options.isHostTarget()) {
+        // the system linker combining the partition objects only knows the host architecture
+        log() << "(IrGen) Objects for another architecture are generated in one partition.\n";
+        jobs = 0;
+    }
+    if (jobs > 0) {
+        log() << "(IrGen) Generating code in " << CodegenPartitions << " partitions on " << jobs << " threads...\n";
+        return joinPartitions(path, fileType, emitPartitions(fileType, jobs));
+    }
 
     std::error_code EC;
     llvm::raw_fd_ostream dest(path, EC, llvm::sys::fs::OF_None);
 
     if (EC) {
         llvm::errs() << "Could not open file: " << EC.message();
-        return;
+        return false;
     }
 
     llvm::legacy::PassManager pass;
 
-    if (theTargetMachine->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
+    if (_targetMachine->addPassesToEmitFile(pass, dest, nullptr, fileType)) {
         llvm::errs() << "TheTargetMachine can't emit a file of this type";
-        return;
+        return false;
     }
 
     pass.run(*_module);
     dest.flush();
+    return true;
+}
+
+bool IrGenerator::joinPartitions(const std::string& path, llvm::Optional<llvm::CodeGenFileType> fileType,
+                                 const std::vector<llvm::SmallVector<char, 0>>& parts) {
+    if (!fileType) {
+        // IR: link the bitcode of the partitions back into one module
+        llvm::LLVMContext context;
+        auto joined = std::make_unique<llvm::Module>(_module->getName(), context);
+        for (auto& part : parts) {
+            auto module = llvm::parseBitcodeFile(
+                llvm::MemoryBufferRef(llvm::StringRef(part.data(), part.size()), "partition"), context);
+            if (!module) throw std::runtime_error(llvm::toString(module.takeError()));
+            if (llvm::Linker::linkModules(*joined, std::move(*module))) {
+                err() << "cannot link the partitions\n";
+                return false;
+            }
+        }
+        std::error_code ec;
+        llvm::raw_fd_ostream dest(path, ec);
+        if (ec) {
+            err() << "cannot write " << path << ": " << ec.message() << "\n";
+            return false;
+        }
+        joined->print(dest, nullptr);
+        return true;
+    }
+
+    if (*fileType == llvm::CGFT_AssemblyFile) {
+        std::error_code ec;
+        llvm::raw_fd_ostream dest(path, ec);
+        if (ec) {
+            err() << "cannot write " << path << ": " << ec.message() << "\n";
+            return false;
+        }
+        auto prefix = _module->getDataLayout().getPrivateGlobalPrefix();
+        for (unsigned i = 0; i < parts.size(); i++) {
+            appendRenamedAssembly(llvm::StringRef(parts[i].data(), parts[i].size()), prefix, i, dest);
+        }
+        return true;
+    }
+
+    std::vector<std::string> objPaths;
+    std::vector<std::unique_ptr<llvm::FileRemover>> removers;
+    for (auto& part : parts) {
+        llvm::SmallString<128> objPath;
+        int fd;
+        if (auto ec = llvm::sys::fs::createTemporaryFile("sysy-part", "o", fd, objPath)) {
+            err() << "cannot create temporary file: " << ec.message() << "\n";
+            return false;
+        }
+        removers.push_back(std::make_unique<llvm::FileRemover>(objPath));
+        llvm::raw_fd_ostream os(fd, true);
+        os.write(part.data(), part.size());
+        objPaths.emplace_back(objPath);
+    }
+    return linkRelocatable(objPaths, path);
+}
+
+bool IrGenerator::outputIncremental(const std::string& path, llvm::Optional<llvm::CodeGenFileType> fileType,
+                                    llvm::OptimizationLevel level, const std::string& cacheDir,
+                                    const std::string& settings) {
+    bool hasDebugInfo = _module->debug_compile_units_begin() != _module->debug_compile_units_end();
+    if (fileType == llvm::CGFT_AssemblyFile && hasDebugInfo) {
+        // see output(): the debug sections of several parts cannot be concatenated as assembly
+        log() << "(IrGen) Assembly with debug info is not generated incrementally.\n";
+        optimizeModule(*_module, level);
+        return output(path, *fileType);
+    }
+    if (fileType == llvm::CGFT_ObjectFile && !_options.isHostTarget()) {
+        // see output(): the objects of the functions cannot be combined
+        log() << "(IrGen) Objects for another architecture are not generated incrementally.\n";
+        optimizeModule(*_module, level);
+        return output(path, *fileType);
+    }
+    log() << "(IrGen) Start incremental code generation...\n";
+    // The canonical form of a function is its AST dump. Functions also depend on the types and constant
+    // values of the globals they use, so every function key contains all global declarations.
+    AstDumper dumper;
+    std::ostringstream globalDecls;
+    std::map<std::string, std::string> funcAsts;
+    for (auto& compUnit : _compUnits) {
+        auto& next = static_cast<const AstCompUnit&>(*compUnit).next();
+        if (auto funcDef = dynamic_cast<const AstFuncDef*>(next.get())) {
+            std::ostringstream ast;
+            dumper.dumpNode(*funcDef, ast);
+            funcAsts[funcDef->id()] = ast.str();
+        } else {
+            dumper.dumpNode(*next, globalDecls);
+        }
+    }
+
+    // every global variable and function goes into its own object, so locals have to be visible to the others
+    for (auto& gv : _module->global_values()) {
+        if (gv.hasLocalLinkage()) {
+            gv.setLinkage(llvm::GlobalValue::ExternalLinkage);
+            gv.setVisibility(llvm::GlobalValue::HiddenVisibility);
+        }
+    }
+
+    auto kind = !fileType ? "bc" : *fileType == llvm::CGFT_AssemblyFile ? "asm" : "obj";
+    auto makeKey = [&](llvm::StringRef part) {
+        llvm::SHA1 hash;
+        // every part names the source file (source_filename, .file)
+        hash.update(settings + "|" + kind + "|" + _module->getSourceFileName() + "|");
+        hash.update(part);
+        return llvm::toHex(hash.final());
+    };
+
+    // all global variables form one part, keyed by their IR
+    std::vector<std::pair<std::string, std::function<bool(const llvm::GlobalValue*)>>> partitions;
+    std::string globalsIR;
+    llvm::raw_string_ostream globalsOS(globalsIR);
+    for (auto& global : _module->globals()) {
+        global.print(globalsOS);
+        llvm::SmallVector<llvm::DIGlobalVariableExpression*, 1> debugInfo;
+        global.getDebugInfo(debugInfo);
+        for (auto expr : debugInfo) {
+            globalsOS << " " << expr->getVariable()->getFilename() << ":" << expr->getVariable()->getLine();
+        }
+    }
+    partitions.emplace_back(makeKey("globals\n" + globalsOS.str()),
+                            [](const llvm::GlobalValue* gv) { return llvm::isa<llvm::GlobalVariable>(gv); });
+
+    for (auto& func : _module->functions()) {
+        if (func.isDeclaration()) continue;
+        std::set<std::string> calleeSigs;
+        for (auto& inst : llvm::instructions(func)) {
+            auto call = llvm::dyn_cast<llvm::CallInst>(&inst);
+            if (!call || !call->getCalledFunction()) continue;
+            std::string sig;
+            llvm::raw_string_ostream sigOS(sig);
+            // the attributes inferred for the callee decide how calls to it are optimized
+            auto callee = call->getCalledFunction();
+            sigOS << callee->getName() << ": " << *call->getFunctionType() << " cc" << callee->getCallingConv() << " "
+                  << callee->getAttributes().getAsString(llvm::AttributeList::FunctionIndex);
+            calleeSigs.insert(sigOS.str());
+        }
+        std::string part = "function " + func.getName().str() + "\n" + funcAsts[func.getName().str()];
+        for (auto& sig : calleeSigs) part += sig + "\n";
+        // whether a parameter is noalias depends on the callers
+        for (auto& arg : func.args()) part += func.getAttributes().getParamAttrs(arg.getArgNo()).getAsString() + "\n";
+        // the AST has no line numbers, but the line table of the function does
+        if (auto subprogram = func.getSubprogram()) {
+            part += subprogram->getFilename().str() + ":" + std::to_string(subprogram->getLine());
+            for (auto& inst : llvm::instructions(func)) {
+                if (auto& loc = inst.getDebugLoc()) part += " " + std::to_string(loc.getLine());
+            }
+            part += "\n";
+        }
+        part += globalDecls.str();
+        // which globals are constant or moved into main depends on the other functions
+        part += globalsOS.str();
+        partitions.emplace_back(makeKey(part), [&func](const llvm::GlobalValue* gv) { return gv == &func; });
+    }
+
+    if (auto ec = llvm::sys::fs::create_directories(cacheDir)) {
+        err() << "cannot create cache directory " << cacheDir << ": " << ec.message() << "\n";
+        return false;
+    }
+    std::vector<llvm::SmallVector<char, 0>> parts(partitions.size());
+    unsigned dirty = 0;
+    for (size_t i = 0; i < partitions.size(); i++) {
+        // only files named llvmcache-* are considered by pruneCache()
+        llvm::SmallString<128> entryPath(cacheDir);
+        llvm::sys::path::append(entryPath, "llvmcache-" + partitions[i].first);
+        if (auto entry = llvm::MemoryBuffer::getFile(entryPath)) {
+            int fd;
+            if (!llvm::sys::fs::openFileForRead(entryPath, fd)) {
+                // mark the entry as recently used for the LRU eviction
+                llvm::sys::fs::setLastAccessAndModificationTime(fd, std::chrono::system_clock::now());
+                llvm::sys::Process::SafelyCloseFileDescriptor(fd);
+            }
+            parts[i].append((*entry)->getBufferStart(), (*entry)->getBufferEnd());
+            continue;
+        }
+
+        dirty++;
+        llvm::ValueToValueMapTy vmap;
+        auto part = llvm::CloneModule(*_module, vmap, partitions[i].second);
+        // functions are optimized on their own, nothing is inlined across them
+        optimizeModule(*part, level);
+        llvm::raw_svector_ostream os(parts[i]);
+        if (fileType) {
+            llvm::legacy::PassManager pass;
+            if (_targetMachine->addPassesToEmitFile(pass, os, nullptr, *fileType)) {
+                llvm::errs() << "TheTargetMachine can't emit a file of this type";
+                return false;
+            }
+            pass.run(*part);
+        } else {
+            llvm::WriteBitcodeToFile(*part, os);
+        }
+
+        // write next to the entry and rename, so others never see a partial entry
+        llvm::SmallString<128> tmpPath(cacheDir);
+        llvm::sys::path::append(tmpPath, "tmp-%%%%%%%%%%%%");
+        int fd;
+        if (llvm::sys::fs::createUniqueFile(tmpPath, fd, tmpPath)) continue;
+        {
+            llvm::raw_fd_ostream tmp(fd, true);
+            tmp.write(parts[i].data(), parts[i].size());
+        }
+        if (llvm::sys::fs::rename(tmpPath, entryPath)) llvm::sys::fs::remove(tmpPath);
+    }
+    log() << "(IrGen) " << dirty << " of " << partitions.size() << " parts compiled, the rest from the cache.\n";
+    return joinPartitions(path, fileType, parts);
+}
+
+int IrGenerator::run() {
+    // the JIT generates code for the host, but honors the selected CPU and features
+    llvm::orc::JITTargetMachineBuilder jtmb(_targetMachine->getTargetTriple());
+    jtmb.setCPU(_options.cpu);
+    jtmb.addFeatures({_options.features});
+    auto jit = llvm::orc::LLJITBuilder().setJITTargetMachineBuilder(std::move(jtmb)).create();
+    if (!jit) {
+        err() << "(JIT) " << llvm::toString(jit.takeError()) << "\n";
+        return 1;
+    }
+    auto& dylib = (*jit)->getMainJITDylib();
+    llvm::orc::MangleAndInterner mangle((*jit)->getExecutionSession(), (*jit)->getDataLayout());
+    auto runtimeSymbol = [](auto func) {
+        return llvm::JITEvaluatedSymbol(llvm::pointerToJITTargetAddress(func), llvm::JITSymbolFlags::Exported);
+    };
+    // resolve calls into the runtime to the copy linked into the compiler
+    llvm::orc::SymbolMap symbols = {{mangle("__sysy_prof_register"), runtimeSymbol(&__sysy_prof_register)}};
+    for (auto& runtime : runtimeFunctions()) {
+        symbols[mangle(runtime.symbol)] = runtimeSymbol(runtime.address);
+    }
+    auto error = dylib.define(llvm::orc::absoluteSymbols(std::move(symbols)));
+    if (!error) error = (*jit)->addIRModule(llvm::orc::ThreadSafeModule(std::move(_module), std::move(_context)));
+    if (error) {
+        err() << "(JIT) " << llvm::toString(std::move(error)) << "\n";
+        return 1;
+    }
+    auto mainSymbol = (*jit)->lookup("main");
+    if (!mainSymbol) {
+        err() << "(JIT) " << llvm::toString(mainSymbol.takeError()) << "\n";
+        return 1;
+    }
+    auto mainFunc = llvm::jitTargetAddressToFunction<int (*)()>(mainSymbol->getAddress());
+    int ret = mainFunc();
+    __sysy_flush();
+    // the counters of an instrumented program live in JIT memory, which is gone by the time the compiler exits
+    __sysy_prof_dump();
+    return ret;
 }
 
 #define RETURN(x) return ret(x)
@@ -104,20 +1397,46 @@ void IrGenerator::visit(const AstBType& node) {
 }
 
 void IrGenerator::visit(const AstVarDecl& node) {
+    if (_builder->GetInsertBlock() == nullptr) {
+        // top level declaration
+        for (auto& def : node.varDefs()) {
+            defineGlobal(*def);
+        }
+        RETURN(nullptr);
+    }
     auto func = _builder->GetInsertBlock()->getParent();
-    llvm::Value* lastStore = nullptr;
+    llvm::Value* lastVal = nullptr;
     for (auto& def : node.varDefs()) {
+        if (!def->arrLens().empty()) {
+            auto dims = evalArrayLens(def->arrLens());
+            auto type = getArrayType(dims);
+            auto allocaInst = createEntryBlockAlloca(func, type, def->id());
+            _namedValues[def->id()] = {0, allocaInst, type, false};
+            if (_diSubprogram) {
+                _diBuilder->insertDeclare(allocaInst, createDebugVariable(def->id(), getDebugType(type)),
+                                          _diBuilder->createExpression(), _builder->getCurrentDebugLocation().get(),
+                                          _builder->GetInsertBlock());
+            }
+            if (def->initVal() != nullptr) initLocalArray(allocaInst, dims, *def->initVal());
+            lastVal = allocaInst;
+            continue;
+        }
         llvm::Value* initVal;
         if (def->initVal() != nullptr) {
             initVal = codegen(*def->initVal()->exp());
         } else {
             initVal = llvm::ConstantInt::get(*_context, llvm::APInt(32, 0, true));
         }
-        auto allocaInst = createEntryBlockAlloca(func, def->id());
-        lastStore = _builder->CreateStore(initVal, allocaInst);
-        _namedValues[def->id()] = allocaInst;
+        auto var = newVariable(def->id(), llvm::Type::getInt32Ty(*_context));
+        writeVariable(var, _builder->GetInsertBlock(), initVal);
+        _namedValues[def->id()] = {var};
+        if (_diSubprogram) {
+            _variables[var].debugVar = createDebugVariable(def->id(), getDebugType(initVal->getType()));
+            emitDebugValue(_variables[var].debugVar, initVal);
+        }
+        lastVal = initVal;
     }
-    RETURN(lastStore);
+    RETURN(lastVal);
 }
 
 void IrGenerator::visit(const AstVarDef& node) {
@@ -129,14 +1448,32 @@ void IrGenerator::visit(const AstInitVal& node) {
 }
 
 void IrGenerator::visit(const AstFuncDef& node) {
-    std::vector<llvm::Type*> params(node.params() == nullptr ? 0 : node.params()->params().size(),
-                                    llvm::Type::getInt32Ty(*_context));
+    std::vector<llvm::Type*> params;
+    // pointee types of array parameters, nullptr for scalars
+    std::vector<llvm::Type*> paramElemTypes;
+    if (node.params() != nullptr) {
+        for (auto& param : node.params()->params()) {
+            if (param->isArray()) {
+                // int a[][N] is passed as a pointer to its first row
+                auto elemType = getArrayType(evalArrayLens(param->arrLens()));
+                params.push_back(elemType->getPointerTo());
+                paramElemTypes.push_back(elemType);
+            } else {
+                params.push_back(llvm::Type::getInt32Ty(*_context));
+                paramElemTypes.push_back(nullptr);
+            }
+        }
+    }
 
     auto retType = node.funcType()->type() == FuncType::INT
                        ? llvm::Type::getInt32Ty(*_context)
                        : llvm::Type::getVoidTy(*_context);
     auto funcType = llvm::FunctionType::get(retType, params, false);
     auto func = llvm::Function::Create(funcType, llvm::Function::ExternalLinkage, node.id(), _module.get());
+    // let the optimizer's cost models see the machine the code is generated for
+    func->addFnAttr("target-cpu", _options.cpu);
+    if (!_options.features.empty()) func->addFnAttr("target-features", _options.features);
+    if (_options.framePointer) func->addFnAttr("frame-pointer", "all");
     size_t idx = 0;
     for (auto& arg : func->args()) {
         arg.setName(node.params()->params()[idx++]->id());
@@ -144,34 +1481,75 @@ void IrGenerator::visit(const AstFuncDef& node) {
 
     auto entryBB = llvm::BasicBlock::Create(*_context, "entry", func);
     _builder->SetInsertPoint(entryBB);
+    sealBlock(entryBB);
     _retBB = llvm::BasicBlock::Create(*_context, "exit");
 
-    _namedValues.clear();
-    if (node.funcType()->type() == FuncType::INT) {
-        _retAlloca = createEntryBlockAlloca(func);
-    } else {
-        _retAlloca = nullptr;
+    if (_diBuilder) {
+        // an array parameter is a pointer to its first element
+        std::vector<llvm::Metadata*> types{retType->isVoidTy() ? nullptr : getDebugType(retType)};
+        for (auto& arg : func->args()) {
+            auto elemType = paramElemTypes[arg.getArgNo()];
+            types.push_back(elemType ? _diBuilder->createPointerType(getDebugType(elemType), _module->getDataLayout().getPointerSizeInBits())
+                                     : getDebugType(arg.getType()));
+        }
+        auto file = _diCompileUnit->getFile();
+        _diSubprogram = _diBuilder->createFunction(
+            file, node.id(), "", file, node.lineno(), _diBuilder->createSubroutineType(_diBuilder->getOrCreateTypeArray(types)),
+            node.lineno(), llvm::DINode::FlagPrototyped, llvm::DISubprogram::SPFlagDefinition);
+        func->setSubprogram(_diSubprogram);
+        _builder->SetCurrentDebugLocation(llvm::DILocation::get(*_context, node.lineno(), 0, _diSubprogram));
     }
+
+    auto globalBindings = _namedValues;
+    _retVar = newVariable("retval", retType);
     for (auto& arg : func->args()) {
-        auto allocaInst = createEntryBlockAlloca(func, static_cast<std::string>(arg.getName()));
-        _builder->CreateStore(&arg, allocaInst);
-        _namedValues[static_cast<std::string>(arg.getName())] = allocaInst;
+        auto name = static_cast<std::string>(arg.getName());
+        if (auto elemType = paramElemTypes[arg.getArgNo()]) {
+            _namedValues[name] = {0, &arg, elemType, true};
+            if (_diSubprogram) {
+                auto type = _diBuilder->createPointerType(getDebugType(elemType), _module->getDataLayout().getPointerSizeInBits());
+                emitDebugValue(createDebugVariable(name, type, arg.getArgNo() + 1), &arg);
+            }
+            continue;
+        }
+        auto var = newVariable(name, arg.getType());
+        writeVariable(var, entryBB, &arg);
+        _namedValues[name] = {var};
+        if (_diSubprogram) {
+            _variables[var].debugVar = createDebugVariable(name, getDebugType(arg.getType()), arg.getArgNo() + 1);
+            emitDebugValue(_variables[var].debugVar, &arg);
+        }
     }
 
     codegen(*node.block());
+    // the epilogue belongs to the closing brace
+    if (_diSubprogram) {
+        _builder->SetCurrentDebugLocation(llvm::DILocation::get(*_context, node.block()->lineno(), 0, _diSubprogram));
+    }
     if (_builder->GetInsertBlock()->getTerminator() == nullptr) _builder->CreateBr(_retBB);
     func->getBasicBlockList().push_back(_retBB);
     _builder->SetInsertPoint(_retBB);
+    sealBlock(_retBB);
     llvm::Value* retV = nullptr;
-    if (node.funcType()->type() == FuncType::INT) retV = _builder->CreateLoad(_retAlloca->getAllocatedType(), _retAlloca);
+    if (node.funcType()->type() == FuncType::INT) retV = readVariable(_retVar, _retBB);
     _builder->CreateRet(retV);
 
+    // drop the blocks that no path reaches, e.g. the merge block of an if whose branches both return
+    llvm::removeUnreachableBlocks(*func);
+    _variables.clear();
+    _currentDef.clear();
+    _incompletePhis.clear();
+    _sealedBlocks.clear();
+    _namedValues = globalBindings;
+    _builder->ClearInsertionPoint();
+    if (_diSubprogram) {
+        _diBuilder->finalizeSubprogram(_diSubprogram);
+        _diSubprogram = nullptr;
+        _builder->SetCurrentDebugLocation(llvm::DebugLoc());
+    }
+
     verifyFunction(*func, &llvm::errs());
-    //    _fpm->run(*func);
     RETURN(func);
-
-    // func->eraseFromParent();
-    // RETURN(nullptr);
 }
 
 void IrGenerator::visit(const AstFuncType& node) {
@@ -190,6 +1568,8 @@ void IrGenerator::visit(const AstBlock& node) {
     llvm::Value* retVal = nullptr;
     for (auto& item : node.items()) {
         retVal = codegen(*item);
+        // items after 'return', 'break' or 'continue' are dead code
+        if (_builder->GetInsertBlock()->getTerminator() != nullptr) break;
     }
     RETURN(retVal);
 }
@@ -200,10 +1580,17 @@ void IrGenerator::visit(const AstBlockItem& node) {
 
 void IrGenerator::visit(const AstAssignStmt& node) {
     auto val = codegen(*node.exp());
-    auto variable = _namedValues[node.lVal()->id()];
-    if (!variable) throw std::runtime_error("unknown variable name");
-    auto assign = _builder->CreateStore(val, variable);
-    RETURN(assign);
+    auto& symbol = lookupSymbol(node.lVal()->id());
+    if (!symbol.addr) {
+        if (!node.lVal()->indices().empty()) throw std::runtime_error("subscripted value is not an array");
+        writeVariable(symbol.var, _builder->GetInsertBlock(), val);
+        emitDebugValue(_variables[symbol.var].debugVar, val);
+        RETURN(val);
+    }
+    llvm::Type* type;
+    auto addr = lvalAddress(*node.lVal(), type);
+    if (!type->isIntegerTy()) throw std::runtime_error("array type is not assignable");
+    RETURN(_builder->CreateStore(val, addr));
 }
 
 void IrGenerator::visit(const AstExpStmt& node) {
@@ -218,80 +1605,137 @@ void IrGenerator::visit(const AstBlockStmt& node) {
 }
 
 void IrGenerator::visit(const AstIfStmt& node) {
-    auto condV = codegen(*node.cond());
-    // condV might be i1, convert it to i32
-    condV = _builder->CreateIntCast(condV, llvm::Type::getInt32Ty(*_context), true);
-    // If condV != 0 then goto thenBB, else goto elseBB
-    condV = _builder->CreateICmpNE(condV, llvm::ConstantInt::get(*_context, llvm::APInt(32, 0, true)), "ifcond");
     auto func = _builder->GetInsertBlock()->getParent();
 
-    auto thenBB = llvm::BasicBlock::Create(*_context, "if.then", func);
-    auto elseBB = llvm::BasicBlock::Create(*_context, "if.else");
+    auto thenBB = llvm::BasicBlock::Create(*_context, "if.then");
     auto mergeBB = llvm::BasicBlock::Create(*_context, "if.end");
+    // without an else branch the condition jumps to the merge block directly
+    auto elseBB = node.elseStmt() ? llvm::BasicBlock::Create(*_context, "if.else") : mergeBB;
 
-    _builder->CreateCondBr(condV, thenBB, elseBB);
+    condgen(*node.cond(), thenBB, elseBB);
+    sealBlock(thenBB);
 
+    func->getBasicBlockList().push_back(thenBB);
     _builder->SetInsertPoint(thenBB);
-    auto thenV = codegen(*node.stmt());
-    thenBB = _builder->GetInsertBlock();
+    // a constant condition leaves the branch without predecessors, don't generate its dead code
+    if (llvm::pred_empty(thenBB))
+        _builder->CreateUnreachable();
+    else
+        codegen(*node.stmt());
     if (_builder->GetInsertBlock()->getTerminator() == nullptr) _builder->CreateBr(mergeBB);
 
-    func->getBasicBlockList().push_back(elseBB);
-    _builder->SetInsertPoint(elseBB);
-    auto elseV = node.elseStmt() ? codegen(*node.elseStmt()) : nullptr;
-    elseBB = _builder->GetInsertBlock();
-    if (_builder->GetInsertBlock()->getTerminator() == nullptr) _builder->CreateBr(mergeBB);
+    if (node.elseStmt()) {
+        sealBlock(elseBB);
+        func->getBasicBlockList().push_back(elseBB);
+        _builder->SetInsertPoint(elseBB);
+        if (llvm::pred_empty(elseBB))
+            _builder->CreateUnreachable();
+        else
+            codegen(*node.elseStmt());
+        if (_builder->GetInsertBlock()->getTerminator() == nullptr) _builder->CreateBr(mergeBB);
+    }
 
     func->getBasicBlockList().push_back(mergeBB);
     _builder->SetInsertPoint(mergeBB);
+    sealBlock(mergeBB);
+    // both branches returned, so nothing after the if statement is reachable
+    if (llvm::pred_empty(mergeBB)) _builder->CreateUnreachable();
     RETURN(mergeBB);
 }
 
+/**
+ * Loops are emitted in rotated form, the condition is tested once before entering and then
+ * at the bottom of the loop:
+ *
+ *          cond ? body : end
+ *   body:  ...
+ *   cond:  (continue target) cond ? body : end     <- the single latch, carries llvm.loop
+ *   end:   (break target)
+ */
 void IrGenerator::visit(const AstWhileStmt& node) {
     auto func = _builder->GetInsertBlock()->getParent();
-    auto condBB = llvm::BasicBlock::Create(*_context, "while.cond", func);
     auto bodyBB = llvm::BasicBlock::Create(*_context, "while.body");
+    auto condBB = llvm::BasicBlock::Create(*_context, "while.cond");
+    auto latchBB = llvm::BasicBlock::Create(*_context, "while.latch");
     auto endBB = llvm::BasicBlock::Create(*_context, "while.end");
 
-    _builder->CreateBr(condBB);
-    _builder->SetInsertPoint(condBB);
-    auto condV = codegen(*node.cond());
-    condV = _builder->CreateIntCast(condV, llvm::Type::getInt32Ty(*_context), true);
-    // If condV != 0 then goto thenBB, else goto elseBB
-    condV = _builder->CreateICmpNE(condV, llvm::ConstantInt::get(*_context, llvm::APInt(32, 0, true)), "whilecond");
-    _builder->CreateCondBr(condV, bodyBB, endBB);
+    // guard
+    condgen(*node.cond(), bodyBB, endBB);
 
-    func->getBasicBlockList().push_back(bodyBB);
-    _builder->SetInsertPoint(bodyBB);
-
-    codegen(*node.stmt());
-    if (_builder->GetInsertBlock()->getTerminator() == nullptr) _builder->CreateBr(condBB);
+    if (llvm::pred_empty(bodyBB)) {
+        // the condition is constant false, the loop never runs
+        delete bodyBB;
+        delete condBB;
+        delete latchBB;
+    } else {
+        func->getBasicBlockList().push_back(bodyBB);
+        _builder->SetInsertPoint(bodyBB);
+        _loops.push_back({condBB, endBB});
+        codegen(*node.stmt());
+        _loops.pop_back();
+        if (_builder->GetInsertBlock()->getTerminator() == nullptr) _builder->CreateBr(condBB);
+
+        if (llvm::pred_empty(condBB)) {
+            // the body never reaches its end, i.e. it always breaks or returns
+            delete condBB;
+            delete latchBB;
+        } else {
+            sealBlock(condBB);
+            func->getBasicBlockList().push_back(condBB);
+            _builder->SetInsertPoint(condBB);
+            auto exits = std::distance(llvm::pred_begin(endBB), llvm::pred_end(endBB));
+            condgen(*node.cond(), latchBB, endBB);
+            // a condition that can't exit is constant true, such loops must not be assumed to terminate
+            bool mustProgress = std::distance(llvm::pred_begin(endBB), llvm::pred_end(endBB)) > exits;
+
+            // '&&' and '||' may branch back from several blocks, funnel them through one latch block
+            llvm::Instruction* latch;
+            if (auto pred = latchBB->getSinglePredecessor()) {
+                latch = pred->getTerminator();
+                latch->replaceSuccessorWith(latchBB, bodyBB);
+                delete latchBB;
+            } else {
+                sealBlock(latchBB);
+                func->getBasicBlockList().push_back(latchBB);
+                _builder->SetInsertPoint(latchBB);
+                latch = _builder->CreateBr(bodyBB);
+            }
+            latch->setMetadata(llvm::LLVMContext::MD_loop, createLoopID(mustProgress));
+        }
+        // the back edge is the last predecessor of the loop header
+        sealBlock(bodyBB);
+    }
 
     func->getBasicBlockList().push_back(endBB);
     _builder->SetInsertPoint(endBB);
+    sealBlock(endBB);
+    // only reachable through 'break' in an infinite loop
+    if (llvm::pred_empty(endBB)) _builder->CreateUnreachable();
 
     RETURN(endBB);
 }
 
 void IrGenerator::visit(const AstBreakStmt& node) {
-    RETURN(nullptr);
+    if (_loops.empty()) throw std::runtime_error("'break' statement not in loop statement");
+    RETURN(_builder->CreateBr(_loops.back().breakBB));
 }
 
 void IrGenerator::visit(const AstContinueStmt& node) {
-    RETURN(nullptr);
+    if (_loops.empty()) throw std::runtime_error("'continue' statement not in loop statement");
+    RETURN(_builder->CreateBr(_loops.back().continueBB));
 }
 
 void IrGenerator::visit(const AstReturnStmt& node) {
+    llvm::BranchInst* br;
     if (node.exp() == nullptr) {
         // ret void
-        auto br = _builder->CreateBr(_retBB);
-        RETURN(br);
+        br = _builder->CreateBr(_retBB);
     } else {
         auto retV = codegen(*node.exp());
-        _builder->CreateStore(retV, _retAlloca);
-        auto br = _builder->CreateBr(_retBB);
-        RETURN(br);
+        writeVariable(_retVar, _builder->GetInsertBlock(), retV);
+        br = _builder->CreateBr(_retBB);
     }
+    RETURN(br);
 }
 
 void IrGenerator::visit(const AstExp& node) {
@@ -303,9 +1747,21 @@ void IrGenerator::visit(const AstCond& node) {
 }
 
 void IrGenerator::visit(const AstLVal& node) {
-    auto a = _namedValues[node.id()];
-    if (!a) throw std::runtime_error("unknown variable name");
-    RETURN(_builder->CreateLoad(a->getAllocatedType(), a, node.id().c_str()));
+    auto& symbol = lookupSymbol(node.id());
+    if (!symbol.addr) {
+        if (!node.indices().empty()) throw std::runtime_error("subscripted value is not an array");
+        RETURN(readVariable(symbol.var, _builder->GetInsertBlock()));
+    }
+    llvm::Type* type;
+    auto addr = lvalAddress(node, type);
+    if (type->isArrayTy()) {
+        // an array used as a value (i.e. passed to a function) decays to a pointer to its first element
+        auto zero = llvm::ConstantInt::get(*_context, llvm::APInt(32, 0, true));
+        RETURN(_builder->CreateInBoundsGEP(type, addr, {zero, zero}, "arraydecay"));
+    }
+    // an array parameter without indices is already the pointer to pass on
+    if (symbol.decayed && node.indices().empty()) RETURN(addr);
+    RETURN(_builder->CreateLoad(type, addr, node.id()));
 }
 
 void IrGenerator::visit(const AstPrimaryExp& node) {
@@ -317,40 +1773,51 @@ void IrGenerator::visit(const AstNumber& node) {
 }
 
 void IrGenerator::visit(const AstBinaryExp& node) {
+    if (node.op() == BinaryOp::LOGICAND || node.op() == BinaryOp::LOGICOR) {
+        // a logical expression used as a value: branch on it and merge 1 / 0
+        auto func = _builder->GetInsertBlock()->getParent();
+        auto trueBB = llvm::BasicBlock::Create(*_context, "logic.true");
+        auto falseBB = llvm::BasicBlock::Create(*_context, "logic.false");
+        auto endBB = llvm::BasicBlock::Create(*_context, "logic.end");
+        condgen(node, trueBB, falseBB);
+        for (auto bb : {trueBB, falseBB}) {
+            sealBlock(bb);
+            func->getBasicBlockList().push_back(bb);
+            _builder->SetInsertPoint(bb);
+            _builder->CreateBr(endBB);
+        }
+        sealBlock(endBB);
+        func->getBasicBlockList().push_back(endBB);
+        _builder->SetInsertPoint(endBB);
+        auto phi = _builder->CreatePHI(llvm::Type::getInt32Ty(*_context), 2);
+        phi->addIncoming(llvm::ConstantInt::get(*_context, llvm::APInt(32, 1, true)), trueBB);
+        phi->addIncoming(llvm::ConstantInt::get(*_context, llvm::APInt(32, 0, true)), falseBB);
+        RETURN(phi);
+    }
+
     auto lhs = codegen(*node.lhs());
     if (node.op() == BinaryOp::SINGLE) {
         RETURN(lhs);
     }
     auto rhs = codegen(*node.rhs());
+    if (auto cmp = createCompare(node.op(), lhs, rhs)) {
+        // SysY expressions are int
+        RETURN(_builder->CreateZExt(cmp, llvm::Type::getInt32Ty(*_context)));
+    }
+    // signed overflow is undefined in SysY as in C
     switch (node.op()) {
         case BinaryOp::PLUS:
-            RETURN(_builder->CreateAdd(lhs, rhs));
+            RETURN(_builder->CreateNSWAdd(lhs, rhs));
         case BinaryOp::SUB:
-            RETURN(_builder->CreateSub(lhs, rhs));
+            RETURN(_builder->CreateNSWSub(lhs, rhs));
         case BinaryOp::MUL:
-            RETURN(_builder->CreateMul(lhs, rhs));
+            RETURN(_builder->CreateNSWMul(lhs, rhs));
         case BinaryOp::DIV:
             RETURN(_builder->CreateSDiv(lhs, rhs));
         case BinaryOp::MOD:
             RETURN(_builder->CreateSRem(lhs, rhs));
-        case BinaryOp::LESS:
-            RETURN(_builder->CreateICmpSLT(lhs, rhs));
-        case BinaryOp::GREATER:
-            RETURN(_builder->CreateICmpSGT(lhs, rhs));
-        case BinaryOp::LESSEQ:
-            RETURN(_builder->CreateICmpSLE(lhs, rhs));
-        case BinaryOp::GREATEREQ:
-            RETURN(_builder->CreateICmpSGE(lhs, rhs));
-        case BinaryOp::EQUAL:
-            RETURN(_builder->CreateICmpEQ(lhs, rhs));
-        case BinaryOp::NEQUAL:
-            RETURN(_builder->CreateICmpNE(lhs, rhs));
-        case BinaryOp::LOGICAND:
-            RETURN(_builder->CreateLogicalAnd(lhs, rhs));
-        case BinaryOp::LOGICOR:
-            RETURN(_builder->CreateLogicalOr(lhs, rhs));
-        case BinaryOp::SINGLE:
-            break;
+        default:
+            throw std::runtime_error("unexpected binary operator");
     }
 }
 
@@ -361,9 +1828,11 @@ void IrGenerator::visit(const AstUnaryExp& node) {
             // no effect
             RETURN(exp);
         case UnaryOp::MINUS:
-            RETURN(_builder->CreateMul(exp, llvm::ConstantInt::get(*_context, llvm::APInt(32, -1, true))));
+            RETURN(_builder->CreateNSWNeg(exp));
         case UnaryOp::NOT:
-            RETURN(_builder->CreateNot(exp));
+            // logical not: 1 if exp == 0, otherwise 0
+            RETURN(_builder->CreateZExt(_builder->CreateICmpEQ(exp, llvm::ConstantInt::get(exp->getType(), 0)),
+                                        llvm::Type::getInt32Ty(*_context)));
         case UnaryOp::SINGLE:
             // func call / primary exp
             RETURN(exp);
@@ -376,6 +1845,11 @@ void IrGenerator::visit(const AstFuncRParams& node) {
 
 void IrGenerator::visit(const AstFuncCall& node) {
     auto func = _module->getFunction(node.id());
+    auto runtime = findRuntimeFunction(node.id());
+    if (!func && runtime && runtime->passesLine) {
+        if (!node.params().empty()) throw std::runtime_error("Incorrent arguments passed");
+        RETURN(_builder->CreateCall(_module->getFunction(runtime->symbol), {_builder->getInt32(node.lineno())}));
+    }
     if (!func) throw std::runtime_error("Unknown function reference");
     if (node.params().size() != func->arg_size()) throw std::runtime_error("Incorrent arguments passed");
 
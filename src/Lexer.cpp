@@ -51,6 +51,12 @@ void Lexer::lex() {
     _hasError = false;
     std::optional<Token> token;
 
+    if (!_inputStream.is_open()) {
+        err() << "(Lexer) cannot open the source file.\n";
+        _hasError = true;
+        return;
+    }
+
     log() << "(Lexer) Start lexing...\n";
     while (true) {
         try {
@@ -19,11 +19,11 @@
 #define BOLDWHITE "\033[1m\033[37m"   /* Bold White */
 
 std::ostream& Logger::log() {
-    std::cerr << BOLDGREEN << "[log] " << RESET;
-    return std::cerr;
+    *_out << BOLDGREEN << "[log] " << RESET;
+    return *_out;
 }
 
 std::ostream& Logger::err() {
-    std::cerr << BOLDRED << "[error] " << RESET;
-    return std::cerr;
+    *_out << BOLDRED << "[error] " << RESET;
+    return *_out;
 }
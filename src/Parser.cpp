@@ -222,6 +222,7 @@ AstVarDeclPtr Parser::parseVarDecl() {
 AstVarDefPtr Parser::parseVarDef() {
     std::vector<AstExpPtr> arrLens;
     AstInitValPtr initVal;
+    int lineno = curToken().getLineno();
     auto id = parseID();
     while (true) {
         if (tryMatch(TokenType::LSQBRA)) {
@@ -235,7 +236,9 @@ AstVarDefPtr Parser::parseVarDef() {
     if (tryMatch(TokenType::ASSIGN)) {
         initVal = parseInitVal();
     }
-    return makeAstNode<AstVarDef>(id, std::move(arrLens), std::move(initVal));
+    auto def = makeAstNode<AstVarDef>(id, std::move(arrLens), std::move(initVal));
+    def->setLineno(lineno);
+    return def;
 }
 
 /**
@@ -245,6 +248,10 @@ AstInitValPtr Parser::parseInitVal() {
     if (tryMatch(TokenType::LBRACE)) {
         // -> '{' [InitVal { ',' InitVal }] '}'
         std::vector<AstInitValPtr> initVals;
+        if (tryMatch(TokenType::RBRACE)) {
+            // -> '{' '}', all zeros
+            return makeAstNode<AstInitVal>(std::move(initVals));
+        }
         auto initVal = parseInitVal();
         initVals.push_back(std::move(initVal));
         while (tryToken(TokenType::COMMA)) {
@@ -252,7 +259,7 @@ AstInitValPtr Parser::parseInitVal() {
             initVal = parseInitVal();
             initVals.push_back(std::move(initVal));
         }
-        nextToken();  // skip ';'
+        match(TokenType::RBRACE);
         return makeAstNode<AstInitVal>(std::move(initVals));
     } else {
         // -> Exp
@@ -266,13 +273,16 @@ AstInitValPtr Parser::parseInitVal() {
  */
 AstFuncDefPtr Parser::parseFuncDef() {
     auto funcType = parseFuncType();
+    int lineno = curToken().getLineno();
     auto id = parseID();
     match(TokenType::LPARENT);
     AstFuncFParamsPtr params;
     if (!tryToken(TokenType::RPARENT)) params = parseFuncFParams();
     match(TokenType::RPARENT);
     auto block = parseBlock();
-    return makeAstNode<AstFuncDef>(std::move(funcType), id, std::move(params), std::move(block));
+    auto funcDef = makeAstNode<AstFuncDef>(std::move(funcType), id, std::move(params), std::move(block));
+    funcDef->setLineno(lineno);
+    return funcDef;
 }
 
 /**
@@ -303,11 +313,18 @@ AstFuncFParamsPtr Parser::parseFuncFParams() {
  * FuncFParam -> BType Ident [ '[' ']' { '[' Exp ']' } ]
  */
 AstFuncFParamPtr Parser::parseFuncFParam() {
-    // TODO: array support
-
     auto type = parseBType();
     auto id = parseID();
-    return makeAstNode<AstFuncFParam>(std::move(type), id);
+    if (!tryMatch(TokenType::LSQBRA)) return makeAstNode<AstFuncFParam>(std::move(type), id);
+
+    // -> array parameter, the first dimension is empty
+    match(TokenType::RSQBRA);
+    std::vector<AstExpPtr> arrLens;
+    while (tryMatch(TokenType::LSQBRA)) {
+        arrLens.push_back(parseExp());
+        match(TokenType::RSQBRA);
+    }
+    return makeAstNode<AstFuncFParam>(std::move(type), id, std::move(arrLens));
 }
 
 /**
@@ -353,6 +370,8 @@ AstBlockItemPtr Parser::parseBlockItem() {
  *          | 'return' [Exp] ';'
  */
 AstNodePtr Parser::parseStmt() {
+    // 'if' and 'while' are located at their keyword rather than at the end of their bodies
+    int lineno = curToken().getLineno();
     if (tryMatch(TokenType::IF)) {
         // -> 'if' '( Cond ')' Stmt [ 'else' Stmt ]
         match(TokenType::LPARENT);
@@ -363,14 +382,18 @@ AstNodePtr Parser::parseStmt() {
         if (tryMatch(TokenType::ELSE)) {
             elseStmt = parseStmt();
         }
-        return makeAstNode<AstIfStmt>(std::move(cond), std::move(stmt), std::move(elseStmt));
+        auto ifStmt = makeAstNode<AstIfStmt>(std::move(cond), std::move(stmt), std::move(elseStmt));
+        ifStmt->setLineno(lineno);
+        return ifStmt;
     } else if (tryMatch(TokenType::WHILE)) {
         // -> 'while' '(' Cond ')' Stmt
         match(TokenType::LPARENT);
         auto cond = parseCond();
         match(TokenType::RPARENT);
         auto stmt = parseStmt();
-        return makeAstNode<AstWhileStmt>(std::move(cond), std::move(stmt));
+        auto whileStmt = makeAstNode<AstWhileStmt>(std::move(cond), std::move(stmt));
+        whileStmt->setLineno(lineno);
+        return whileStmt;
     } else if (tryMatch(TokenType::BREAK)) {
         // -> 'break' ';'
         match(TokenType::SEMICN);
@@ -474,7 +497,7 @@ AstNumberPtr Parser::parseNumber() {
  *          | FuncCall | UnaryOp UnaryExp
  */
 AstUnaryExpPtr Parser::parseUnaryExp() {
-    if (tryTokenAhead(1, TokenType::LPARENT)) {
+    if (tryToken(TokenType::ID) && tryTokenAhead(1, TokenType::LPARENT)) {
         // -> FuncCall
         return makeAstNode<AstUnaryExp>(parseFuncCall());
     } else if (tryToken(TokenType::PLUS, TokenType::SUB, TokenType::NOT)) {
@@ -507,6 +530,8 @@ AstFuncRParamsPtr Parser::parseFuncRParams() {
  * FuncCall -> Ident '(' [Exp {',' Exp}] ')'
  */
 AstFuncCallPtr Parser::parseFuncCall() {
+    // the line of the name, which starttime() and stoptime() pass to the runtime
+    int lineno = curToken().getLineno();
     auto id = parseID();
     match(TokenType::LPARENT);
     AstNodePtrVector params;
@@ -522,7 +547,9 @@ AstFuncCallPtr Parser::parseFuncCall() {
         }
     }
     match(TokenType::RPARENT);
-    return makeAstNode<AstFuncCall>(id, std::move(params));
+    auto call = makeAstNode<AstFuncCall>(id, std::move(params));
+    call->setLineno(lineno);
+    return call;
 }
 
 AstNodePtr Parser::parseBinaryExp() {
@@ -0,0 +1,28 @@
+#include "Runtime.hpp"
+
+extern "C" {
+#include "sylib.h"
+}
+
+const std::vector<RuntimeFunction>& runtimeFunctions() {
+    using T = RuntimeType;
+    static const std::vector<RuntimeFunction> functions = {
+        {"getint", "getint", T::INT, {}, false, reinterpret_cast<void*>(&getint)},
+        {"getch", "getch", T::INT, {}, false, reinterpret_cast<void*>(&getch)},
+        {"getarray", "getarray", T::INT, {T::INT_ARRAY_OUT}, false, reinterpret_cast<void*>(&getarray)},
+        {"putint", "putint", T::VOID, {T::INT}, false, reinterpret_cast<void*>(&putint)},
+        {"putch", "putch", T::VOID, {T::INT}, false, reinterpret_cast<void*>(&putch)},
+        {"putarray", "putarray", T::VOID, {T::INT, T::INT_ARRAY_IN}, false, reinterpret_cast<void*>(&putarray)},
+        // starttime() and stoptime() are macros passing __LINE__ in the C declarations of the runtime
+        {"starttime", "_sysy_starttime", T::VOID, {T::INT}, true, reinterpret_cast<void*>(&_sysy_starttime)},
+        {"stoptime", "_sysy_stoptime", T::VOID, {T::INT}, true, reinterpret_cast<void*>(&_sysy_stoptime)},
+    };
+    return functions;
+}
+
+const RuntimeFunction* findRuntimeFunction(const std::string& name) {
+    for (auto& func : runtimeFunctions()) {
+        if (name == func.name) return &func;
+    }
+    return nullptr;
+}
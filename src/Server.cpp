@@ -0,0 +1,234 @@
+#include "Server.hpp"
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#include <sstream>
+#include <llvm/Support/FileUtilities.h>
+#include <llvm/Support/MemoryBuffer.h>
+#include <llvm/Support/Path.h>
+#include <llvm/Support/ThreadPool.h>
+#include "Logger.hpp"
+
+static bool writeAll(int fd, const char* data, size_t size) {
+    while (size > 0) {
+        // a client that went away must not kill the server with SIGPIPE
+        auto n = send(fd, data, size, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool readAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        auto n = read(fd, data, size);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) return false;
+        data += n;
+        size -= n;
+    }
+    return true;
+}
+
+static bool writeFrame(int fd, llvm::StringRef data) {
+    uint32_t size = htonl(data.size());
+    return writeAll(fd, reinterpret_cast<const char*>(&size), sizeof(size)) && writeAll(fd, data.data(), data.size());
+}
+
+static bool readFrame(int fd, std::string& data) {
+    uint32_t size;
+    if (!readAll(fd, reinterpret_cast<char*>(&size), sizeof(size))) return false;
+    data.resize(ntohl(size));
+    return readAll(fd, &data[0], data.size());
+}
+
+static bool makeSocketAddress(const std::string& socketPath, sockaddr_un& addr) {
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (socketPath.size() >= sizeof(addr.sun_path)) {
+        err() << "socket path is too long: " << socketPath << "\n";
+        return false;
+    }
+    strcpy(addr.sun_path, socketPath.c_str());
+    return true;
+}
+
+/**
+ * @brief Compile a request's source into a temporary file with the request's arguments.
+ *
+ * @return the exit code of the compilation
+ */
+static int compileRequest(const std::vector<std::string>& args, const std::string& source,
+                          const std::string& runtimePath, std::string& output) {
+    CommandLine cmd;
+    cmd.options.runtimePath = runtimePath;
+    if (!parseCommandLine(args, cmd)) return 1;
+    if (cmd.isBatch() || cmd.options.target == RUN || !cmd.serverSocket.empty() || !cmd.clientSocket.empty()) {
+        err() << "the compile server only compiles single files\n";
+        return 1;
+    }
+
+    llvm::SmallString<128> inPath, outPath;
+    // the extension tells SysY source from LLVM IR and bitcode
+    auto extension = llvm::sys::path::extension(cmd.inFilePaths[0]);
+    if (auto ec = llvm::sys::fs::createTemporaryFile("sysy-server", extension.empty() ? "sy" : extension.drop_front(),
+                                                     inPath)) {
+        err() << "cannot create temporary file: " << ec.message() << "\n";
+        return 1;
+    }
+    llvm::FileRemover inRemover(inPath);
+    if (auto ec = llvm::sys::fs::createTemporaryFile("sysy-server", "out", outPath)) {
+        err() << "cannot create temporary file: " << ec.message() << "\n";
+        return 1;
+    }
+    llvm::FileRemover outRemover(outPath);
+    {
+        std::error_code ec;
+        llvm::raw_fd_ostream in(inPath, ec);
+        in << source;
+    }
+
+    cmd.options.sourceName = cmd.inFilePaths[0];
+    cmd.inFilePaths = {std::string(inPath)};
+    cmd.outFilePath = std::string(outPath);
+    int ret = runCommandLine(cmd);
+    if (ret == 0) {
+        auto buffer = llvm::MemoryBuffer::getFile(outPath);
+        if (!buffer) {
+            err() << "cannot read the output: " << buffer.getError().message() << "\n";
+            return 1;
+        }
+        output = (*buffer)->getBuffer().str();
+    }
+    return ret;
+}
+
+static void serveConnection(int conn, const std::string& runtimePath) {
+    std::string argBlob, source;
+    if (!readFrame(conn, argBlob) || !readFrame(conn, source)) return;
+    llvm::SmallVector<llvm::StringRef, 16> argRefs;
+    llvm::StringRef(argBlob).split(argRefs, '\0', -1, false);
+    std::vector<std::string> args(argRefs.begin(), argRefs.end());
+
+    std::ostringstream messages;
+    std::string output;
+    logger().redirect(&messages);
+    int ret = compileRequest(args, source, runtimePath, output);
+    logger().redirect(nullptr);
+
+    writeFrame(conn, std::to_string(ret)) && writeFrame(conn, messages.str()) && writeFrame(conn, output);
+}
+
+int runServer(const std::string& socketPath, const std::string& runtimePath) {
+    sockaddr_un addr;
+    if (!makeSocketAddress(socketPath, addr)) return 1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        err() << "cannot create socket: " << strerror(errno) << "\n";
+        return 1;
+    }
+    // a socket left behind by a previous server
+    unlink(socketPath.c_str());
+    if (bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0 || listen(fd, SOMAXCONN) < 0) {
+        err() << "cannot listen on " << socketPath << ": " << strerror(errno) << "\n";
+        close(fd);
+        return 1;
+    }
+    log() << "(Server) listening on " << socketPath << "\n";
+
+    llvm::ThreadPool pool(llvm::hardware_concurrency());
+    while (true) {
+        int conn = accept(fd, nullptr, nullptr);
+        if (conn < 0) {
+            if (errno == EINTR) continue;
+            err() << "accept failed: " << strerror(errno) << "\n";
+            break;
+        }
+        pool.async([conn, &runtimePath] {
+            serveConnection(conn, runtimePath);
+            close(conn);
+        });
+    }
+    pool.wait();
+    close(fd);
+    unlink(socketPath.c_str());
+    return 1;
+}
+
+int runClient(const CommandLine& cmd, const std::vector<std::string>& args) {
+    if (cmd.isBatch() || cmd.options.target == RUN) return runCommandLine(cmd);
+    // an unreadable input is reported by the local compiler exactly as without a server
+    auto source = llvm::MemoryBuffer::getFile(cmd.inFilePaths[0]);
+    if (!source) return runCommandLine(cmd);
+
+    sockaddr_un addr;
+    if (!makeSocketAddress(cmd.clientSocket, addr)) return 1;
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) < 0) {
+        if (fd >= 0) close(fd);
+        log() << "(Client) no compile server on " << cmd.clientSocket << ", compiling locally.\n";
+        return runCommandLine(cmd);
+    }
+
+    // the server has another working directory, so it gets the source instead of the input path
+    std::string argBlob;
+    for (size_t i = 0; i < args.size(); i++) {
+        if (args[i] == "--client") {
+            i++;
+            continue;
+        }
+        std::string arg = args[i];
+        if (arg == cmd.inFilePaths[0]) {
+            // named in debug info
+            llvm::SmallString<128> inFilePath(arg);
+            llvm::sys::fs::make_absolute(inFilePath);
+            arg = std::string(inFilePath);
+        } else {
+            // paths the compiler opens; -fprofile-generate= is opened by the program when it runs
+            for (auto prefix : {"--runtime=", "--cache-dir=", "-fprofile-use="}) {
+                if (arg.rfind(prefix, 0) != 0) continue;
+                llvm::SmallString<128> path(arg.substr(strlen(prefix)));
+                llvm::sys::fs::make_absolute(path);
+                arg = prefix + std::string(path);
+                break;
+            }
+        }
+        argBlob += arg;
+        argBlob += '\0';
+    }
+
+    std::string status, messages, output;
+    bool ok = writeFrame(fd, argBlob) && writeFrame(fd, (*source)->getBuffer()) && readFrame(fd, status) &&
+              readFrame(fd, messages) && readFrame(fd, output);
+    close(fd);
+    if (!ok) {
+        err() << "lost the connection to the compile server\n";
+        return 1;
+    }
+    std::cerr << messages;
+    int ret;
+    if (llvm::StringRef(status).getAsInteger(10, ret)) {
+        err() << "invalid exit code from the compile server: " << status << "\n";
+        return 1;
+    }
+    if (ret != 0) return ret;
+
+    std::error_code ec;
+    llvm::raw_fd_ostream out(cmd.outFilePath, ec);
+    if (ec) {
+        err() << "cannot write " << cmd.outFilePath << ": " << ec.message() << "\n";
+        return 1;
+    }
+    out << output;
+    out.close();
+    if (cmd.options.target == EXE) {
+        llvm::sys::fs::setPermissions(cmd.outFilePath, llvm::sys::fs::all_read | llvm::sys::fs::all_exe |
+                                                            llvm::sys::fs::owner_write);
+    }
+    return 0;
+}
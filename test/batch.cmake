@@ -0,0 +1,58 @@
+# Compile the golden sources in SOURCE_DIR with COMPILER -s in WORK_DIR one by one, then as a batch of input files
+# and through a batch manifest, and check that the batches write the same assembly to the expected paths.
+file(GLOB sources ${SOURCE_DIR}/*.sy)
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/single)
+
+foreach (source ${sources})
+    get_filename_component(name ${source} NAME_WE)
+    execute_process(COMMAND ${COMPILER} -s -O2 ${source} -o ${WORK_DIR}/single/${name}.s
+                    RESULT_VARIABLE ret ERROR_VARIABLE log)
+    if (NOT ret EQUAL 0)
+        message(FATAL_ERROR "compiling ${source} failed:\n${log}")
+    endif ()
+endforeach ()
+
+# Check that every source was compiled by the batch into dir, the first one into first.
+macro (compare_outputs dir first)
+    foreach (source ${sources})
+        get_filename_component(name ${source} NAME_WE)
+        set(out ${dir}/${name}.s)
+        if (source STREQUAL first)
+            set(out ${first})
+        endif ()
+        execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/single/${name}.s ${out}
+                        RESULT_VARIABLE differ)
+        if (NOT differ EQUAL 0)
+            message(FATAL_ERROR "the batch output ${out} differs from the output of a single compilation")
+        endif ()
+    endforeach ()
+endmacro ()
+
+execute_process(COMMAND ${COMPILER} -s -O2 -j2 ${sources} -o ${WORK_DIR}/batch
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling the batch failed:\n${log}")
+endif ()
+compare_outputs(${WORK_DIR}/batch "")
+
+# the first source names its output, the others go to the -o directory; a missing file fails on its own
+list(GET sources 0 first)
+set(manifest "# golden sources\n${first} ${WORK_DIR}/first.s\n${SOURCE_DIR}/missing.sy\n")
+foreach (source ${sources})
+    if (NOT source STREQUAL first)
+        set(manifest "${manifest}${source}\n")
+    endif ()
+endforeach ()
+file(WRITE ${WORK_DIR}/manifest.txt ${manifest})
+execute_process(COMMAND ${COMPILER} -s -O2 --batch=${WORK_DIR}/manifest.txt -o ${WORK_DIR}/manifest
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (ret EQUAL 0 OR NOT log MATCHES "failed to compile ${SOURCE_DIR}/missing.sy")
+    message(FATAL_ERROR "the missing file did not fail the batch:\n${log}")
+endif ()
+string(REGEX MATCHALL "failed to compile" failures "${log}")
+list(LENGTH failures failed)
+if (NOT failed EQUAL 1)
+    message(FATAL_ERROR "compiling the manifest failed:\n${log}")
+endif ()
+compare_outputs(${WORK_DIR}/manifest ${WORK_DIR}/first.s)
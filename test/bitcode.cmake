@@ -0,0 +1,23 @@
+# Compile SOURCE with COMPILER -O2 in WORK_DIR, once directly and once from the bitcode written by -emit-bc, and
+# check that both give the same assembly.
+get_filename_component(name ${SOURCE} NAME_WE)
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+execute_process(COMMAND ${COMPILER} -emit-bc ${SOURCE} -o ${WORK_DIR}/${name}.bc
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling ${SOURCE} to bitcode failed:\n${log}")
+endif ()
+foreach (input ${SOURCE} ${WORK_DIR}/${name}.bc)
+    get_filename_component(extension ${input} EXT)
+    execute_process(COMMAND ${COMPILER} -s -O2 ${input} -o ${WORK_DIR}/${name}${extension}.s
+                    RESULT_VARIABLE ret ERROR_VARIABLE log)
+    if (NOT ret EQUAL 0)
+        message(FATAL_ERROR "compiling ${input} failed:\n${log}")
+    endif ()
+endforeach ()
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/${name}.sy.s ${WORK_DIR}/${name}.bc.s
+                RESULT_VARIABLE differ)
+if (NOT differ EQUAL 0)
+    message(FATAL_ERROR "the assembly compiled from the bitcode of ${name} differs from that of the source")
+endif ()
@@ -0,0 +1,97 @@
+# Compile the golden sources in SOURCE_DIR with COMPILER -s --cache-dir in WORK_DIR, and check that an unchanged
+# source is found in the compile cache with the same output, that other options miss it, and that --cache-size
+# evicts the least recently used entries.
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(cache ${WORK_DIR}/cache)
+
+# Compile source into out with the cache and the extra arguments, setting hit to whether it was found in the cache.
+macro (compile source out hit)
+    execute_process(COMMAND ${COMPILER} -s --cache-dir=${cache} ${ARGN} ${source} -o ${out}
+                    RESULT_VARIABLE ret ERROR_VARIABLE log)
+    if (NOT ret EQUAL 0)
+        message(FATAL_ERROR "compiling ${source} failed:\n${log}")
+    endif ()
+    if (log MATCHES "found in the compile cache")
+        set(${hit} TRUE)
+    else ()
+        set(${hit} FALSE)
+    endif ()
+endmacro ()
+
+macro (count_entries count)
+    file(GLOB entries ${cache}/llvmcache-*)
+    list(LENGTH entries ${count})
+endmacro ()
+
+# the output names the source, so a is a copy that can be edited in place
+configure_file(${SOURCE_DIR}/whole_program.sy ${WORK_DIR}/whole_program.sy COPYONLY)
+set(a ${WORK_DIR}/whole_program.sy)
+set(b ${SOURCE_DIR}/array_kernels.sy)
+set(c ${SOURCE_DIR}/global_promotion.sy)
+
+compile(${a} ${WORK_DIR}/a.s hit)
+if (hit)
+    message(FATAL_ERROR "${a} was found in an empty cache")
+endif ()
+compile(${a} ${WORK_DIR}/a.hit.s hit)
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/a.s ${WORK_DIR}/a.hit.s
+                RESULT_VARIABLE differ)
+if (NOT hit OR NOT differ EQUAL 0)
+    message(FATAL_ERROR "the second compilation of ${a} was not a cache hit with the same output")
+endif ()
+
+# trailing spaces and tabs don't change the key
+file(READ ${a} source)
+string(REPLACE "\n" " \t\n" source "${source}")
+file(WRITE ${a} "${source}\n\n")
+compile(${a} ${WORK_DIR}/spaces.s hit)
+if (NOT hit)
+    message(FATAL_ERROR "trailing whitespace missed the cache")
+endif ()
+
+# but a carriage return is an error for the lexer
+string(REPLACE "\n" "\r\n" crlf "${source}")
+file(WRITE ${a} "${crlf}")
+execute_process(COMMAND ${COMPILER} -s --cache-dir=${cache} ${a} -o ${WORK_DIR}/crlf.s
+                RESULT_VARIABLE ret OUTPUT_QUIET ERROR_QUIET)
+if (ret EQUAL 0)
+    message(FATAL_ERROR "a source with CRLF line endings was found in the cache")
+endif ()
+file(WRITE ${a} "${source}")
+
+# the same source elsewhere is another file name in the output
+compile(${SOURCE_DIR}/whole_program.sy ${WORK_DIR}/other.s hit)
+if (hit)
+    message(FATAL_ERROR "another path to the same source found the first one in the cache")
+endif ()
+
+compile(${a} ${WORK_DIR}/a.O2.s hit -O2)
+if (hit)
+    message(FATAL_ERROR "-O2 found the -O0 output in the cache")
+endif ()
+
+compile(${b} ${WORK_DIR}/b.s hit)
+compile(${c} ${WORK_DIR}/c.s hit)
+count_entries(count)
+if (NOT count EQUAL 5)
+    message(FATAL_ERROR "expected 5 cache entries, found ${count}")
+endif ()
+
+# a cap of c's entry keeps only c, which was just used
+file(READ ${WORK_DIR}/c.s bytes HEX)
+string(LENGTH "${bytes}" size)
+math(EXPR size "${size} / 2")
+compile(${c} ${WORK_DIR}/c.hit.s hit --cache-size=${size})
+count_entries(count)
+if (NOT hit OR NOT count EQUAL 1)
+    message(FATAL_ERROR "--cache-size=${size} left ${count} cache entries")
+endif ()
+compile(${c} ${WORK_DIR}/c.hit.s hit)
+if (NOT hit)
+    message(FATAL_ERROR "pruning evicted the most recently used entry")
+endif ()
+compile(${a} ${WORK_DIR}/a.s hit)
+if (hit)
+    message(FATAL_ERROR "pruning kept a least recently used entry")
+endif ()
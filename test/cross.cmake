@@ -0,0 +1,17 @@
+# Compile SOURCE with COMPILER --target=TRIPLE to assembly in WORK_DIR and check that the LLVM assembler LLVM_MC
+# accepts it for CPU.
+get_filename_component(name ${SOURCE} NAME_WE)
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(asm ${WORK_DIR}/${name}.s)
+
+execute_process(COMMAND ${COMPILER} -s -O2 --target=${TRIPLE} ${SOURCE} -o ${asm}
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling ${SOURCE} for ${TRIPLE} failed:\n${log}")
+endif ()
+
+execute_process(COMMAND ${LLVM_MC} -triple=${TRIPLE} -mcpu=${CPU} -filetype=obj ${asm} -o ${WORK_DIR}/${name}.o
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "assembling ${asm} failed:\n${log}")
+endif ()
@@ -0,0 +1,29 @@
+# Compile SOURCE (whole_program.sy) with COMPILER -c -g in WORK_DIR and check with LLVM_DWARFDUMP that the object
+# has line table rows for its statements and debug info for its functions and variables.
+get_filename_component(name ${SOURCE} NAME_WE)
+get_filename_component(filename ${SOURCE} NAME)
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(obj ${WORK_DIR}/${name}.o)
+
+execute_process(COMMAND ${COMPILER} -c -g ${SOURCE} -o ${obj} RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling ${SOURCE} failed:\n${log}")
+endif ()
+
+execute_process(COMMAND ${LLVM_DWARFDUMP} --debug-line ${obj} RESULT_VARIABLE ret OUTPUT_VARIABLE lines)
+if (NOT ret EQUAL 0 OR NOT lines MATCHES "name: \"${filename}\"")
+    message(FATAL_ERROR "the line table does not name ${filename}:\n${lines}")
+endif ()
+# the return of square, the recursion of fib and the first call in main
+foreach (line 5 10 37)
+    if (NOT lines MATCHES "\n0x[0-9a-f]+ +${line} ")
+        message(FATAL_ERROR "the line table has no row for line ${line}:\n${lines}")
+    endif ()
+endforeach ()
+
+execute_process(COMMAND ${LLVM_DWARFDUMP} --debug-info ${obj} RESULT_VARIABLE ret OUTPUT_VARIABLE info)
+foreach (entity square fib main counter table x s)
+    if (NOT info MATCHES "DW_AT_name\t\\(\"${entity}\"\\)")
+        message(FATAL_ERROR "the debug info has no entry for ${entity}:\n${info}")
+    endif ()
+endforeach ()
@@ -0,0 +1,28 @@
+# Compile SOURCE (global_promotion.sy) with COMPILER -i in WORK_DIR and check the promotion of its globals: those
+# never written become constant, the scalar only main uses becomes a local of main, and the others stay globals.
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+execute_process(COMMAND ${COMPILER} -i ${SOURCE} -o ${WORK_DIR}/global_promotion.ll
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling ${SOURCE} failed:\n${log}")
+endif ()
+file(READ ${WORK_DIR}/global_promotion.ll ir)
+
+foreach (global n scale tab)
+    if (NOT ir MATCHES "\n@${global} = internal constant ")
+        message(FATAL_ERROR "${global} is not constant:\n${ir}")
+    endif ()
+endforeach ()
+# f writes counter, and work is an array
+foreach (global counter work)
+    if (NOT ir MATCHES "\n@${global} = internal global ")
+        message(FATAL_ERROR "${global} is not a global variable:\n${ir}")
+    endif ()
+endforeach ()
+if (ir MATCHES "\n@acc = ")
+    message(FATAL_ERROR "acc is still a global:\n${ir}")
+endif ()
+if (NOT ir MATCHES "%acc[0-9]* = alloca i32")
+    message(FATAL_ERROR "acc is not a local of main:\n${ir}")
+endif ()
@@ -0,0 +1,51 @@
+# Compile SOURCE with COMPILER -backend=BACKEND and the optional FLAGS in WORK_DIR, run it and compare its output
+# with the .out file; BACKEND=jit runs it with -run instead, and BACKEND=bitcode compiles it through -emit-bc.
+# As in the SysY test suites, the last line of the .out file is the exit code of the program. Trailing whitespace
+# is ignored.
+get_filename_component(name ${SOURCE} NAME_WE)
+get_filename_component(dir ${SOURCE} DIRECTORY)
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(exe ${WORK_DIR}/${name})
+
+separate_arguments(FLAGS)
+if (BACKEND STREQUAL jit)
+    set(run ${COMPILER} -run ${FLAGS} ${SOURCE})
+elseif (BACKEND STREQUAL bitcode)
+    execute_process(COMMAND ${COMPILER} -emit-bc ${FLAGS} ${SOURCE} -o ${exe}.bc
+                    RESULT_VARIABLE ret ERROR_VARIABLE log)
+    if (ret EQUAL 0)
+        execute_process(COMMAND ${COMPILER} ${FLAGS} ${exe}.bc -o ${exe} RESULT_VARIABLE ret ERROR_VARIABLE log)
+    endif ()
+    if (NOT ret EQUAL 0)
+        message(FATAL_ERROR "compiling ${SOURCE} through bitcode failed:\n${log}")
+    endif ()
+    set(run ${exe})
+else ()
+    execute_process(COMMAND ${COMPILER} -backend=${BACKEND} ${FLAGS} ${SOURCE} -o ${exe}
+                    RESULT_VARIABLE ret ERROR_VARIABLE log)
+    if (NOT ret EQUAL 0)
+        message(FATAL_ERROR "compiling ${SOURCE} failed:\n${log}")
+    endif ()
+    set(run ${exe})
+endif ()
+
+set(input /dev/null)
+if (EXISTS ${dir}/${name}.in)
+    set(input ${dir}/${name}.in)
+endif ()
+execute_process(COMMAND ${run} INPUT_FILE ${input} OUTPUT_VARIABLE output RESULT_VARIABLE status TIMEOUT 10)
+if (NOT status MATCHES "^[0-9]+$")
+    message(FATAL_ERROR "running ${name} failed: ${status}")
+endif ()
+
+file(READ ${dir}/${name}.out expected)
+string(REGEX REPLACE "[ \t\r\n]+$" "" output "${output}")
+if (output STREQUAL "")
+    set(output ${status})
+else ()
+    set(output "${output}\n${status}")
+endif ()
+string(REGEX REPLACE "[ \t\r\n]+$" "" expected "${expected}")
+if (NOT output STREQUAL expected)
+    message(FATAL_ERROR "unexpected output of ${name}:\n${output}\nexpected:\n${expected}")
+endif ()
@@ -0,0 +1,44 @@
+# Compile SOURCE (whole_program.sy) with COMPILER -s --incremental in WORK_DIR, edit one of its functions and
+# check that only that function is compiled again, into the same assembly as a compilation from an empty cache.
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# Compile source with the cache in cache, setting parts to the "<compiled> of <all>" parts.
+macro (compile source cache out parts)
+    execute_process(COMMAND ${COMPILER} -s -O2 --incremental --cache-dir=${cache} ${source} -o ${out}
+                    RESULT_VARIABLE ret ERROR_VARIABLE log)
+    if (NOT ret EQUAL 0)
+        message(FATAL_ERROR "compiling ${source} failed:\n${log}")
+    endif ()
+    if (NOT log MATCHES "([0-9]+ of [0-9]+) parts compiled")
+        message(FATAL_ERROR "${source} was not compiled incrementally:\n${log}")
+    endif ()
+    set(${parts} ${CMAKE_MATCH_1})
+endmacro ()
+
+# the output names the source, so it is edited in place
+configure_file(${SOURCE} ${WORK_DIR}/whole_program.sy COPYONLY)
+set(copy ${WORK_DIR}/whole_program.sy)
+compile(${copy} ${WORK_DIR}/cache ${WORK_DIR}/before.s parts)
+string(REGEX MATCH "^[0-9]+" compiled ${parts})
+if (NOT parts STREQUAL "${compiled} of ${compiled}")
+    message(FATAL_ERROR "only ${parts} parts were compiled with an empty cache")
+endif ()
+
+file(READ ${copy} source)
+string(REPLACE "return x * x;" "return x * x + 1;" edited "${source}")
+if (edited STREQUAL source)
+    message(FATAL_ERROR "square() not found in ${SOURCE}")
+endif ()
+file(WRITE ${copy} "${edited}")
+compile(${copy} ${WORK_DIR}/cache ${WORK_DIR}/edited.s parts)
+if (NOT parts MATCHES "^1 of ")
+    message(FATAL_ERROR "${parts} parts were compiled again after editing one function")
+endif ()
+
+compile(${copy} ${WORK_DIR}/fresh ${WORK_DIR}/fresh.s parts)
+execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/edited.s ${WORK_DIR}/fresh.s
+                RESULT_VARIABLE differ)
+if (NOT differ EQUAL 0)
+    message(FATAL_ERROR "the incremental output differs from a compilation from an empty cache")
+endif ()
@@ -0,0 +1,21 @@
+# Compile SOURCE with COMPILER -O2 at -j1 and -j4 in WORK_DIR, as assembly and as an object, and check that the
+# outputs are the same byte for byte.
+get_filename_component(name ${SOURCE} NAME_WE)
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+foreach (type s c)
+    foreach (jobs 1 4)
+        set(out ${WORK_DIR}/${name}.j${jobs}.${type})
+        execute_process(COMMAND ${COMPILER} -${type} -O2 -j${jobs} ${SOURCE} -o ${out}
+                        RESULT_VARIABLE ret ERROR_VARIABLE log)
+        if (NOT ret EQUAL 0)
+            message(FATAL_ERROR "compiling ${SOURCE} with -${type} -j${jobs} failed:\n${log}")
+        endif ()
+    endforeach ()
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/${name}.j1.${type}
+                            ${WORK_DIR}/${name}.j4.${type}
+                    RESULT_VARIABLE differ)
+    if (NOT differ EQUAL 0)
+        message(FATAL_ERROR "the -${type} output of ${name} differs between -j1 and -j4")
+    endif ()
+endforeach ()
@@ -0,0 +1,38 @@
+# Build SOURCE (whole_program.sy) with COMPILER -fprofile-generate in WORK_DIR, run it, and check that -i with
+# -fprofile-use attaches the entry counts and branch weights of the run to fib.
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR})
+set(profile ${WORK_DIR}/whole_program.sysyprof)
+
+execute_process(COMMAND ${COMPILER} -fprofile-generate=${profile} ${SOURCE} -o ${WORK_DIR}/instrumented
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling ${SOURCE} failed:\n${log}")
+endif ()
+execute_process(COMMAND ${WORK_DIR}/instrumented RESULT_VARIABLE ret OUTPUT_QUIET TIMEOUT 10)
+if (NOT ret EQUAL 0 OR NOT EXISTS ${profile})
+    message(FATAL_ERROR "the instrumented program did not write a profile")
+endif ()
+
+execute_process(COMMAND ${COMPILER} -i -fprofile-use=${profile} ${SOURCE} -o ${WORK_DIR}/whole_program.ll
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling ${SOURCE} with the profile failed:\n${log}")
+endif ()
+file(READ ${WORK_DIR}/whole_program.ll ir)
+
+# Check that the !prof reference matched by regex in fib is the given metadata.
+macro (check_prof regex metadata)
+    set(prof "")
+    if (fib MATCHES "${regex}")
+        set(prof ${CMAKE_MATCH_1})
+    endif ()
+    if (prof STREQUAL "" OR NOT ir MATCHES "\n${prof} = !{${metadata}}")
+        message(FATAL_ERROR "fib has no ${metadata}:\n${ir}")
+    endif ()
+endmacro ()
+
+# fib(10) is entered 177 times, and 89 of them return n
+string(REGEX MATCH "@fib\\([^\n]*\n[^}]*}" fib "${ir}")
+check_prof("!prof (![0-9]+) {" "!\"function_entry_count\", i64 177")
+check_prof("br i1 [^\n]*!prof (![0-9]+)" "!\"branch_weights\", i32 89, i32 88")
@@ -0,0 +1,86 @@
+# Start COMPILER --server on a temporary socket, compile SOURCE through it with --client in WORK_DIR, and check that
+# the results are the same as those of local compilations and that the server, not the fallback, compiled them.
+# Relative paths in the options are those of the client's working directory, not of the server's.
+get_filename_component(name ${SOURCE} NAME_WE)
+file(REMOVE_RECURSE ${WORK_DIR})
+file(MAKE_DIRECTORY ${WORK_DIR}/client)
+
+# unix socket paths are short, so the socket can't live in the build directory
+set(tmp /tmp)
+if (DEFINED ENV{TMPDIR})
+    set(tmp $ENV{TMPDIR})
+endif ()
+string(RANDOM LENGTH 8 suffix)
+set(socket ${tmp}/sysy-test-${suffix}.sock)
+
+execute_process(COMMAND sh -c "\"$0\" --server \"$1\" >\"$2\" 2>&1 & echo $!"
+                        ${COMPILER} ${socket} ${WORK_DIR}/server.log
+                WORKING_DIRECTORY ${WORK_DIR}
+                OUTPUT_VARIABLE pid OUTPUT_STRIP_TRAILING_WHITESPACE)
+foreach (i RANGE 50)
+    if (NOT EXISTS ${socket})
+        execute_process(COMMAND ${CMAKE_COMMAND} -E sleep 0.1)
+    endif ()
+endforeach ()
+
+set(error "")
+if (NOT EXISTS ${socket})
+    set(error "the compile server did not start")
+endif ()
+foreach (type s c)
+    if (error STREQUAL "")
+        execute_process(COMMAND ${COMPILER} --client ${socket} -${type} -O2 ${SOURCE}
+                                -o ${WORK_DIR}/${name}.client.${type}
+                        RESULT_VARIABLE ret ERROR_VARIABLE log)
+        execute_process(COMMAND ${COMPILER} -${type} -O2 ${SOURCE} -o ${WORK_DIR}/${name}.local.${type}
+                        RESULT_VARIABLE localRet)
+        execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${WORK_DIR}/${name}.client.${type}
+                                ${WORK_DIR}/${name}.local.${type}
+                        RESULT_VARIABLE differ)
+        if (NOT ret EQUAL 0 OR NOT localRet EQUAL 0)
+            set(error "compiling ${SOURCE} with -${type} failed:\n${log}")
+        elseif (log MATCHES "compiling locally")
+            set(error "the client did not reach the compile server:\n${log}")
+        elseif (NOT differ EQUAL 0)
+            set(error "the -${type} output of the compile server differs from a local compilation")
+        endif ()
+    endif ()
+endforeach ()
+
+# a profile and a cache directory relative to the client
+set(client ${WORK_DIR}/client)
+execute_process(COMMAND ${COMPILER} -fprofile-generate=${client}/${name}.sysyprof ${SOURCE} -o ${client}/instrumented
+                RESULT_VARIABLE ret ERROR_QUIET)
+if (ret EQUAL 0)
+    execute_process(COMMAND ${client}/instrumented RESULT_VARIABLE ret OUTPUT_QUIET TIMEOUT 10)
+endif ()
+if (NOT ret EQUAL 0 AND error STREQUAL "")
+    set(error "writing the profile of ${SOURCE} failed")
+endif ()
+if (error STREQUAL "")
+    set(args -s -O2 -fprofile-use=${name}.sysyprof ${SOURCE})
+    execute_process(COMMAND ${COMPILER} --client ${socket} --cache-dir=cache ${args} -o ${name}.client.s
+                    WORKING_DIRECTORY ${client}
+                    RESULT_VARIABLE ret ERROR_VARIABLE log)
+    execute_process(COMMAND ${COMPILER} ${args} -o ${name}.local.s
+                    WORKING_DIRECTORY ${client}
+                    RESULT_VARIABLE localRet)
+    execute_process(COMMAND ${CMAKE_COMMAND} -E compare_files ${client}/${name}.client.s ${client}/${name}.local.s
+                    RESULT_VARIABLE differ)
+    file(GLOB entries ${client}/cache/llvmcache-*)
+    if (NOT ret EQUAL 0 OR NOT localRet EQUAL 0)
+        set(error "compiling ${SOURCE} with a relative profile and cache failed:\n${log}")
+    elseif (log MATCHES "compiling locally")
+        set(error "the client did not reach the compile server:\n${log}")
+    elseif (NOT differ EQUAL 0)
+        set(error "the output of the compile server with a relative profile differs from a local compilation")
+    elseif (NOT entries OR EXISTS ${WORK_DIR}/cache)
+        set(error "the compile server did not use the cache directory relative to the client")
+    endif ()
+endif ()
+
+execute_process(COMMAND kill ${pid})
+file(REMOVE ${socket})
+if (NOT error STREQUAL "")
+    message(FATAL_ERROR ${error})
+endif ()
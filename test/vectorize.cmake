@@ -0,0 +1,30 @@
+# Compile SOURCE (array_kernels.sy) with COMPILER in WORK_DIR and check that -Rpass=loop-vectorize reports the
+# loops of its kernels as vectorized, and that -i gives noalias to the array parameters no call aliases.
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# as a whole program, the kernels would be inlined into main and folded away
+execute_process(COMMAND ${COMPILER} -s -O2 -fno-whole-program -Rpass=loop-vectorize ${SOURCE}
+                        -o ${WORK_DIR}/array_kernels.s
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling ${SOURCE} failed:\n${log}")
+endif ()
+foreach (kernel axpy shiftg sum)
+    if (NOT log MATCHES "in ${kernel}: vectorized loop")
+        message(FATAL_ERROR "the loop of ${kernel} was not vectorized:\n${log}")
+    endif ()
+endforeach ()
+
+execute_process(COMMAND ${COMPILER} -i ${SOURCE} -o ${WORK_DIR}/array_kernels.ll
+                RESULT_VARIABLE ret ERROR_VARIABLE log)
+if (NOT ret EQUAL 0)
+    message(FATAL_ERROR "compiling ${SOURCE} failed:\n${log}")
+endif ()
+file(READ ${WORK_DIR}/array_kernels.ll ir)
+if (NOT ir MATCHES "@sum\\(i32\\* noalias %x")
+    message(FATAL_ERROR "the array parameter of sum is not noalias:\n${ir}")
+endif ()
+# axpy(h, h, ...) passes the same array twice
+if (ir MATCHES "@axpy\\([^)]*noalias")
+    message(FATAL_ERROR "the array parameters of axpy are noalias although they alias:\n${ir}")
+endif ()
@@ -0,0 +1,44 @@
+# Compile SOURCE (whole_program.sy) with COMPILER -i in WORK_DIR and check the annotations of the whole program:
+# functions other than main are internal with the fast calling convention and get the inferred memory attributes.
+file(MAKE_DIRECTORY ${WORK_DIR})
+
+# Compile with the given flags into the variable ir.
+macro (compile_ir flags)
+    execute_process(COMMAND ${COMPILER} -i ${flags} ${SOURCE} -o ${WORK_DIR}/whole_program.ll
+                    RESULT_VARIABLE ret ERROR_VARIABLE log)
+    if (NOT ret EQUAL 0)
+        message(FATAL_ERROR "compiling ${SOURCE} failed:\n${log}")
+    endif ()
+    file(READ ${WORK_DIR}/whole_program.ll ir)
+endmacro ()
+
+# Check that function is defined with the given linkage and calling convention, and that its attribute group
+# has attribute.
+macro (check_function function prefix attribute)
+    if (NOT ir MATCHES "define ${prefix} [^\n]*@${function}\\([^\n]*#([0-9]+) {")
+        message(FATAL_ERROR "${function} is not defined as '${prefix}':\n${ir}")
+    endif ()
+    if (NOT ir MATCHES "attributes #${CMAKE_MATCH_1} = {[^}\n]* ${attribute}[ }]")
+        message(FATAL_ERROR "${function} is not ${attribute}:\n${ir}")
+    endif ()
+endmacro ()
+
+# -O2 inlines everything but the recursive fib into main
+compile_ir(-O2)
+check_function(fib "internal fastcc i32" readnone)
+if (NOT ir MATCHES "@counter = internal ")
+    message(FATAL_ERROR "counter is not internal:\n${ir}")
+endif ()
+
+compile_ir(-O0)
+check_function(square "internal fastcc i32" readnone)
+check_function(total "internal fastcc i32" readonly)
+check_function(bump "internal fastcc void" nounwind)
+if (ir MATCHES "define internal[^\n]*@main\\(")
+    message(FATAL_ERROR "main is internal:\n${ir}")
+endif ()
+
+compile_ir(-fno-whole-program)
+if (ir MATCHES "internal|fastcc")
+    message(FATAL_ERROR "-fno-whole-program still made functions internal:\n${ir}")
+endif ()